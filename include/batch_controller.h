@@ -0,0 +1,107 @@
+/*
+ * Адаптивний розмір пачки для обробника буфера.
+ *
+ * Замість фіксованих "10 рядків, 1мс кожні 5 рядків, 10мс сну":
+ *   - розмір пачки оцінюється з заповнення кільця і середньої
+ *     довжини рядка, але обмежується бюджетом часу на цикл
+ *     (за середньою вартістю рядка), щоб watchdog завжди отримував
+ *     свій тік;
+ *   - після циклу під навантаженням - мінімальна пауза,
+ *     без даних - довге очікування (будить USB callback).
+ */
+#pragma once
+
+#include <string.h>
+#include "logger_port.h"
+
+struct BatchConfig {
+    uint32_t minLines;      // Не менше стількох рядків за цикл (якщо вони є)
+    uint32_t maxLines;      // Жорстка межа пачки
+    uint32_t budgetUs;      // Бюджет процесорного часу на один цикл
+    uint32_t busyWaitMs;    // Пауза між циклами під навантаженням (для watchdog)
+    uint32_t idleWaitMs;    // Максимальне очікування нових даних
+    uint8_t highWaterPct;   // Вище цього заповнення кільця - ніколи не чекаємо довго
+};
+
+struct BatchStats {
+    uint32_t cycles;
+    uint32_t lines;
+    uint32_t busyCycles;      // Цикли, що вичерпали ліміт або бюджет
+    uint32_t budgetOverruns;  // Цикли, що вийшли за бюджет часу
+    uint32_t maxCycleUs;
+    uint32_t maxBatch;
+};
+
+class BatchController {
+public:
+    BatchController() : avgLineUsQ4(16 * 20), avgLineBytesQ4(16 * 64), lastWaitMs(1) {
+        BatchConfig defaults = { 4, 256, 5000, 1, 100, 50 };
+        configure(defaults);
+    }
+
+    void configure(const BatchConfig &config) {
+        cfg = config;
+        memset(&st, 0, sizeof(st));
+    }
+
+    const BatchConfig &config() const { return cfg; }
+    const BatchStats &stats() const { return st; }
+    void resetStats() { memset(&st, 0, sizeof(st)); }
+    uint32_t avgLineUs() const { return avgLineUsQ4 >> 4; }
+    uint32_t avgLineBytes() const { return avgLineBytesQ4 >> 4; }
+
+    // Скільки рядків обробити в цьому циклі
+    uint32_t beginCycle(size_t fillBytes) const {
+        uint32_t lineBytes = avgLineBytes() + 1;
+        uint32_t pendingLines = (uint32_t)(fillBytes / lineBytes) + 1;
+        uint32_t lineUs = avgLineUs() > 0 ? avgLineUs() : 1;
+        uint32_t byBudget = cfg.budgetUs / lineUs;
+
+        uint32_t limit = pendingLines < byBudget ? pendingLines : byBudget;
+        if (limit < cfg.minLines) limit = cfg.minLines;
+        if (limit > cfg.maxLines) limit = cfg.maxLines;
+        return limit;
+    }
+
+    // Чи є ще час у бюджеті циклу
+    bool withinBudget(uint32_t cycleStartUs) const {
+        return loggerMicros() - cycleStartUs < cfg.budgetUs;
+    }
+
+    // Оновлює оцінки і вирішує, скільки чекати до наступного циклу.
+    // drained - у кільці не лишилось повних рядків
+    uint32_t endCycle(uint32_t lines, uint32_t bytes, uint32_t elapsedUs,
+                      bool drained, size_t fillBytes, size_t capacity) {
+        st.cycles++;
+        st.lines += lines;
+        if (elapsedUs > st.maxCycleUs) st.maxCycleUs = elapsedUs;
+        if (lines > st.maxBatch) st.maxBatch = lines;
+        if (elapsedUs > cfg.budgetUs) st.budgetOverruns++;
+
+        // Ковзні середні (1/8) вартості і довжини рядка, фіксована кома Q4
+        if (lines > 0) {
+            uint32_t lineUsQ4 = (elapsedUs << 4) / lines;
+            uint32_t lineBytesQ4 = (bytes << 4) / lines;
+            avgLineUsQ4 = (avgLineUsQ4 * 7 + lineUsQ4) >> 3;
+            avgLineBytesQ4 = (avgLineBytesQ4 * 7 + lineBytesQ4) >> 3;
+        }
+
+        bool highWater = capacity > 0 && fillBytes * 100 / capacity >= cfg.highWaterPct;
+        if (!drained || highWater) {
+            st.busyCycles++;
+            lastWaitMs = cfg.busyWaitMs;
+        } else {
+            lastWaitMs = cfg.idleWaitMs;
+        }
+        return lastWaitMs;
+    }
+
+    uint32_t waitMs() const { return lastWaitMs; }
+
+private:
+    BatchConfig cfg;
+    BatchStats st;
+    uint32_t avgLineUsQ4;
+    uint32_t avgLineBytesQ4;
+    uint32_t lastWaitMs;
+};
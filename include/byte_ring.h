@@ -0,0 +1,68 @@
+/*
+ * Кільцевий буфер байт: один продюсер (USB callback), один споживач
+ * (обробник буфера). Без блокувань - тільки атомарні індекси, тому
+ * callback ніколи не чекає на обробник і навпаки.
+ */
+#pragma once
+
+#include <string.h>
+#include <atomic>
+#include "logger_port.h"
+
+class ByteRing {
+public:
+    // capacity має бути степенем двійки
+    ByteRing(uint8_t *storage, size_t capacity)
+        : buf(storage), cap(capacity), mask(capacity - 1), head(0), tail(0), dropped(0) {}
+
+    size_t capacity() const { return cap; }
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    uint8_t fillPercent() const { return (uint8_t)(size() * 100 / cap); }
+    uint32_t droppedBytes() const { return dropped; }
+
+    // Продюсер: копіює скільки вміщається, решту рахує як втрачене
+    size_t write(const uint8_t *data, size_t len) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t room = cap - (h - t);
+        if (len > room) {
+            dropped += len - room;
+            len = room;
+        }
+        size_t pos = h & mask;
+        size_t first = len < cap - pos ? len : cap - pos;
+        memcpy(buf + pos, data, first);
+        memcpy(buf, data + first, len - first);
+        head.store(h + len, std::memory_order_release);
+        return len;
+    }
+
+    // Споживач: неперервний шматок доступних даних (до кінця буфера)
+    size_t peek(const uint8_t **ptr) const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t avail = head.load(std::memory_order_acquire) - t;
+        size_t pos = t & mask;
+        if (avail > cap - pos) avail = cap - pos;
+        *ptr = buf + pos;
+        return avail;
+    }
+
+    void consume(size_t len) {
+        tail.store(tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+    // Споживач: відкинути все накопичене
+    void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    uint8_t *buf;
+    size_t cap;
+    size_t mask;
+    std::atomic<size_t> head;  // Пише тільки продюсер
+    std::atomic<size_t> tail;  // Пише тільки споживач
+    uint32_t dropped;
+};
@@ -0,0 +1,349 @@
+/*
+ * "Бортовий самописець": останні N МБ рядків у кільці в PSRAM,
+ * на SD нічого не пишеться, поки не спрацює тригер.
+ *
+ * Тригери:
+ *   - підрядок у рядку (ERROR, panic, Guru Meditation ...);
+ *   - ручний (команда trigger);
+ *   - аномалія швидкості потоку: сплеск відносно базової швидкості
+ *     або тиша довше stallMs після стабільного потоку.
+ * Після тригера у вихід (окремий файл) іде все кільце (передісторія)
+ * і далі потік ще postTriggerMs. Повторний тригер під час запису
+ * подовжує вікно.
+ *
+ * Працює як звичайний LogSink - отримує ті самі спільні блоки. write()
+ * тільки копіює блок у кільце; відкриття файлу і вивантаження робить
+ * dump() у власному потоці, тож повільна SD не затримує чергу sink'а.
+ */
+#pragma once
+
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include "log_sink.h"
+
+#define FR_MAX_PATTERNS 4
+#define FR_MAX_PATTERN_LEN 32
+#define FR_DUMP_CHUNK 16384      // Скільки байт вивантажувати за один виклик dump()
+#define FR_COPY_BYTES 4096       // Порція, що копіюється з кільця під блокуванням
+#define FR_RATE_WINDOW_MS 1000
+
+// Куди вивантажувати вікно навколо тригера
+class FlightRecorderOutput {
+public:
+    virtual ~FlightRecorderOutput() {}
+    virtual bool open(const char *reason) = 0;
+    virtual bool write(const char *data, size_t len) = 0;
+    virtual void close() = 0;
+};
+
+struct FlightRecorderConfig {
+    uint32_t postTriggerMs;     // Скільки писати після тригера
+    uint32_t rateSpikeFactor;   // Тригер при швидкості > базова * factor (0 - вимкнено)
+    uint32_t rateMinBytesPerSec;// Нижче цієї базової швидкості аномалії не шукаємо
+    uint32_t stallMs;           // Тригер при тиші довше stallMs (0 - вимкнено)
+};
+
+struct FlightRecorderStats {
+    uint32_t triggers;
+    uint32_t captures;
+    uint32_t bytesRecorded;
+    uint32_t bytesDumped;
+    uint32_t bytesLost;         // Перезаписані до вивантаження
+    uint32_t writeErrors;
+};
+
+class FlightRecorder : public LogSink {
+public:
+    FlightRecorder() : ring(NULL), cap(0), head(0), cursor(0), dumpedUntil(0), skipPartialLine(false),
+                       output(NULL), capturing(false), outputOpen(false), postEndMs(0), patternCount(0),
+                       manualTrigger(false), windowStartMs(0), windowBytes(0), baselineBps(0), lastDataMs(0),
+                       stalled(false) {
+        FlightRecorderConfig defaults = { 10000, 0, 1024, 0 };
+        cfg = defaults;
+        memset(&st, 0, sizeof(st));
+        lastReason[0] = '\0';
+    }
+    ~FlightRecorder() {
+        if (ring != NULL) loggerFree(ring);
+    }
+
+    // Виділяє кільце (на ESP32 - у PSRAM)
+    bool begin(size_t capacity, FlightRecorderOutput *out) {
+        if (ring != NULL) loggerFree(ring);
+        ring = (char *)loggerAlloc(capacity);
+        if (ring == NULL) return false;
+        cap = capacity;
+        output = out;
+        return true;
+    }
+
+    void configure(const FlightRecorderConfig &config) { cfg = config; }
+    const FlightRecorderConfig &config() const { return cfg; }
+
+    bool addPattern(const char *pattern) {
+        size_t len = strlen(pattern);
+        if (patternCount >= FR_MAX_PATTERNS || len == 0 || len >= FR_MAX_PATTERN_LEN) return false;
+        memcpy(patterns[patternCount], pattern, len + 1);
+        patternLen[patternCount++] = len;
+        return true;
+    }
+
+    void clearPatterns() { patternCount = 0; }
+    int patternsCount() const { return patternCount; }
+    const char *pattern(int i) const { return patterns[i]; }
+
+    // Ручний тригер - безпечно викликати з іншого потоку
+    void trigger() { manualTrigger.store(true); }
+
+    bool isCapturing() const { return capturing.load(); }
+    size_t capacity() const { return cap; }
+    // Передісторія, яку ще не вивантажували
+    size_t buffered() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (size_t)(head - windowFloor());
+    }
+    const char *reason() const { return lastReason; }
+    const FlightRecorderStats &stats() const { return st; }
+
+    const char *name() const override { return "recorder"; }
+
+    // Потік sink'а: тільки копія в кільце і пошук тригерів, SD не чіпаємо
+    bool write(const LineBlock &block) override {
+        if (ring == NULL) return false;
+        uint32_t now = loggerMillis();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            record(block.data, block.length);
+        }
+        updateRate(block.length, now);
+
+        if (matchesPattern(block.data, block.length)) {
+            fire("pattern", now);
+        }
+        return true;
+    }
+
+    void poll(uint32_t nowMs) override {
+        if (ring == NULL) return;
+        if (manualTrigger.exchange(false)) {
+            fire("manual", nowMs);
+        }
+
+        // Тиша після стабільного потоку
+        if (cfg.stallMs > 0 && !stalled && baselineBps >= cfg.rateMinBytesPerSec &&
+            lastDataMs != 0 && nowMs - lastDataMs >= cfg.stallMs) {
+            stalled = true;
+            fire("stall", nowMs);
+        }
+    }
+
+    // Окремий потік вивантаження: відкриває вихід після тригера і пише
+    // до FR_DUMP_CHUNK байт за виклик. true - ще є що писати, кликати знову одразу
+    bool dump(uint32_t nowMs) {
+        if (ring == NULL || !capturing.load()) return false;
+
+        if (!outputOpen) {
+            char why[sizeof(lastReason)];
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                memcpy(why, lastReason, sizeof(why));
+            }
+            if (output == NULL || !output->open(why)) {
+                st.writeErrors++;
+                capturing.store(false);
+                return false;
+            }
+            outputOpen = true;
+            st.captures++;
+        }
+
+        size_t budget = FR_DUMP_CHUNK;
+        while (budget > 0) {
+            size_t n = copyOut(budget);
+            if (n == 0) break;
+            // Запис на SD - без блокування, write() тим часом пише в кільце
+            if (!output->write(scratch, n)) st.writeErrors++;
+            st.bytesDumped += n;
+            budget -= n;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (cursor < head) return true;
+        if ((int32_t)(nowMs - postEndMs) < 0) return false;
+        // Наступне вікно не повинно повторювати вже вивантажене
+        dumpedUntil = head;
+        capturing.store(false);
+        lock.unlock();
+        output->close();
+        outputOpen = false;
+        return false;
+    }
+
+    // Очищує кільце (перед новим сеансом, не під час вивантаження)
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        head = cursor = dumpedUntil = 0;
+        capturing.store(false);
+    }
+
+private:
+    uint64_t oldest() const { return head > cap ? head - cap : 0; }
+    uint64_t windowFloor() const { return oldest() > dumpedUntil ? oldest() : dumpedUntil; }
+
+    void record(const char *data, size_t len) {
+        // Дані більші за кільце - лишаємо тільки хвіст
+        if (len > cap) {
+            data += len - cap;
+            head += len - cap;
+            len = cap;
+        }
+        size_t pos = head % cap;
+        size_t first = len < cap - pos ? len : cap - pos;
+        memcpy(ring + pos, data, first);
+        memcpy(ring, data + first, len - first);
+        head += len;
+        st.bytesRecorded += len;
+    }
+
+    void updateRate(size_t len, uint32_t now) {
+        lastDataMs = now;
+        stalled = false;
+        if (windowStartMs == 0) windowStartMs = now;
+        windowBytes += len;
+
+        uint32_t elapsed = now - windowStartMs;
+        if (elapsed < FR_RATE_WINDOW_MS) return;
+
+        uint32_t bps = (uint32_t)((uint64_t)windowBytes * 1000 / elapsed);
+        if (cfg.rateSpikeFactor > 0 && baselineBps >= cfg.rateMinBytesPerSec &&
+            bps > baselineBps * cfg.rateSpikeFactor) {
+            fire("rate-spike", now);
+        }
+        // Базова швидкість - ковзне середнє 1/8
+        baselineBps = baselineBps == 0 ? bps : (baselineBps * 7 + bps) / 8;
+        windowStartMs = now;
+        windowBytes = 0;
+    }
+
+    bool matchesPattern(const char *data, size_t len) const {
+        for (int i = 0; i < patternCount; i++) {
+            size_t plen = patternLen[i];
+            if (len < plen) continue;
+            const char first = patterns[i][0];
+            const char *p = data;
+            const char *end = data + len - plen + 1;
+            while (p < end) {
+                p = (const char *)memchr(p, first, end - p);
+                if (p == NULL) break;
+                if (memcmp(p, patterns[i], plen) == 0) return true;
+                p++;
+            }
+        }
+        return false;
+    }
+
+    // Тільки позначає вікно - файл відкриє потік вивантаження
+    void fire(const char *why, uint32_t now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        st.triggers++;
+        postEndMs = now + cfg.postTriggerMs;
+        if (capturing.load()) return;  // Вже пишемо - тільки подовжили вікно
+
+        snprintf(lastReason, sizeof(lastReason), "%s", why);
+        // Передісторія: все, що ще є в кільці і не потрапило в попереднє вікно
+        cursor = windowFloor();
+        skipPartialLine = cursor > dumpedUntil;
+        capturing.store(true);
+    }
+
+    // Копіює наступну порцію вікна в scratch. Повертає кількість байт (0 - наздогнали запис)
+    size_t copyOut(size_t budget) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cursor < oldest()) {
+            // Запис обігнав вивантаження - ці дані вже перезаписані
+            st.bytesLost += (uint32_t)(oldest() - cursor);
+            cursor = oldest();
+            skipPartialLine = true;
+        }
+
+        while (cursor < head) {
+            size_t pos = cursor % cap;
+            size_t n = (size_t)(head - cursor);
+            if (n > cap - pos) n = cap - pos;
+            if (n > sizeof(scratch)) n = sizeof(scratch);
+            if (n > budget) n = budget;
+
+            // Найстаріший рядок міг бути перезаписаний частково - починаємо з повного
+            if (skipPartialLine) {
+                const char *nl = (const char *)memchr(ring + pos, '\n', n);
+                size_t skip = nl != NULL ? (size_t)(nl - (ring + pos)) + 1 : n;
+                cursor += skip;
+                if (nl != NULL) skipPartialLine = false;
+                continue;
+            }
+
+            memcpy(scratch, ring + pos, n);
+            cursor += n;
+            return n;
+        }
+        return 0;
+    }
+
+    char *ring;
+    size_t cap;
+    uint64_t head;               // Скільки байт записано всього
+    uint64_t cursor;             // До якого байта вивантажено
+    uint64_t dumpedUntil;        // Кінець попереднього вікна - нижня межа наступного
+    bool skipPartialLine;        // Почати вивантаження з першого повного рядка
+    std::mutex mutex;            // head/cursor/вікно: write() і dump() - різні потоки
+    char scratch[FR_COPY_BYTES]; // Порція для запису на SD поза блокуванням
+    FlightRecorderOutput *output;
+    FlightRecorderConfig cfg;
+    std::atomic<bool> capturing; // Тригер спрацював, вікно ще не закрито
+    bool outputOpen;             // Тільки потік вивантаження
+    uint32_t postEndMs;
+    char lastReason[16];
+
+    char patterns[FR_MAX_PATTERNS][FR_MAX_PATTERN_LEN];
+    size_t patternLen[FR_MAX_PATTERNS];
+    int patternCount;
+    std::atomic<bool> manualTrigger;
+
+    uint32_t windowStartMs;
+    uint32_t windowBytes;
+    uint32_t baselineBps;
+    uint32_t lastDataMs;
+    bool stalled;
+
+    FlightRecorderStats st;
+};
+
+// Вихід у файл через stdio - для хоста (прогін записаних логів) і VFS
+class FileRecorderOutput : public FlightRecorderOutput {
+public:
+    explicit FileRecorderOutput(const char *pathPrefix) : prefix(pathPrefix), fp(NULL), index(0) {}
+
+    bool open(const char *reason) override {
+        char path[128];
+        snprintf(path, sizeof(path), "%s_%03u_%s.txt", prefix, index++, reason);
+        fp = fopen(path, "wb");
+        return fp != NULL;
+    }
+
+    bool write(const char *data, size_t len) override {
+        return fp != NULL && fwrite(data, 1, len, fp) == len;
+    }
+
+    void close() override {
+        if (fp != NULL) fclose(fp);
+        fp = NULL;
+    }
+
+private:
+    const char *prefix;
+    FILE *fp;
+    unsigned index;
+};
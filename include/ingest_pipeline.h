@@ -0,0 +1,315 @@
+/*
+ * Конвеєр прийому, складений на етапі компіляції:
+ *     джерело (ByteRing) -> framer -> проріджування -> телеметрія ->
+ *     timestamp -> згортання повторів -> блоки -> sink'и
+ *
+ * Склад і ємності задає структура конфігурації з constexpr полями
+ * (див. DefaultIngestConfig). Етапу, вимкненого в конфігурації, немає
+ * зовсім: ні поля, ні коду, ні перевірки прапорця на кожен рядок - цикл
+ * framer'а розгортається в прямий код до запису в блок. Зібрані етапи
+ * зберігають свої перемикачі часу виконання (команди dedup, decim, telemetry).
+ *
+ * Потоки (кільце + framer кожного) мають власні проріджування і згортання
+ * повторів: однакові рядки різних потоків - не серія, а $ADC різних
+ * інтерфейсів - різні вікна. Номер потоку передається в drain()/finish(),
+ * тег потоку запам'ятовується і ставиться перед рядками, які poll() видає
+ * пізніше (агрегати, підсумки серій). Телеметрія - спільна.
+ *
+ * Джерело часу (Clock) - параметр шаблону. Потрібні методи:
+ *     const char *prefix(); size_t length();  - готовий префікс рядка
+ *     void setTag(const char *tag);           - тег потоку після штампа
+ *     void refresh();                         - на початку пачки
+ *     void tick(uint32_t nowMs);              - на кожен рядок, дешево
+ *     uint64_t unixMs(uint32_t nowMs);        - час для колонок телеметрії
+ */
+#pragma once
+
+#include <stdio.h>
+#include <type_traits>
+#include "line_framer.h"
+#include "log_sink.h"
+#include "line_decimator.h"
+#include "line_dedup.h"
+#include "telemetry_store.h"
+
+// Повний конвеєр. Своя конфігурація - нащадок з перевизначеними полями
+struct DefaultIngestConfig {
+    static constexpr size_t ringBytes = 16384;       // Кільце одного потоку USB, степінь двійки
+    static constexpr size_t lineMaxLength = 3968;    // Найдовший сегмент (з timestamp і маркерами влазить у блок)
+    static constexpr size_t blockBytes = 4096;       // Один запис на SD замість десятків
+    static constexpr size_t blockCount = 32;
+    static constexpr size_t blockMinFree = 256;      // Майже повний блок відправляємо одразу
+    static constexpr uint32_t blockFlushMs = 50;     // Неповний блок - не пізніше ніж через 50мс
+    static constexpr uint32_t telemetryFlushMs = 60000;
+    static constexpr int streams = 1;                // Потоків з власним станом проріджування і повторів
+
+    static constexpr bool decimation = true;
+    static constexpr bool telemetry = true;
+    static constexpr bool dedup = true;
+};
+
+// Місце етапу, якого немає в конфігурації
+struct NoStage {};
+
+template <bool Enabled, typename Stage>
+using IngestStage = typename std::conditional<Enabled, Stage, NoStage>::type;
+
+// Кінець конвеєра: рядки з префіксом складаються в спільний блок,
+// повний або застарілий блок розсилається sink'ам
+template <typename Cfg>
+class BlockWriter {
+public:
+    BlockWriter(LineBlockPool &blockPool, SinkFanout &sinkFanout)
+        : pool(blockPool), fanout(sinkFanout), current(NULL), lost(0) {}
+
+    void append(const char *prefix, size_t prefixLen, const char *line, size_t len) {
+        if (current == NULL) current = pool.acquire();
+        if (current == NULL) {
+            lineLost();
+            return;
+        }
+        if (current->appendLine(prefix, prefixLen, line, len)) return;
+
+        // Блок заповнений - відправляємо і беремо новий
+        publish();
+        current = pool.acquire();
+        if (current == NULL) {
+            lineLost();
+            return;
+        }
+        // Рядок довший за блок - обрізаємо до розміру блоку
+        size_t maxLen = current->capacity - prefixLen - 1;
+        if (len > maxLen) len = maxLen;
+        current->appendLine(prefix, prefixLen, line, len);
+    }
+
+    // Одна резервація на пачку: якщо пачка не влізе в поточний блок - відправляємо його одразу
+    void reserve(size_t bytes) {
+        if (bytes > Cfg::blockBytes) bytes = Cfg::blockBytes;
+        if (current != NULL && current->freeSpace() < bytes) publish();
+        if (current == NULL) current = pool.acquire();
+    }
+
+    void publish() {
+        if (current == NULL) return;
+        if (current->lines > 0) {
+            fanout.publish(current);
+        } else {
+            current->release();
+        }
+        current = NULL;
+    }
+
+    // Неповний блок не тримаємо довго - Serial має бачити рядки майже одразу.
+    // true - блок відправлено
+    bool poll(uint32_t nowMs) {
+        if (current == NULL) return false;
+        if (current->freeSpace() >= Cfg::blockMinFree && nowMs - current->createdMs < Cfg::blockFlushMs) return false;
+        publish();
+        return true;
+    }
+
+    // Скільки можна спати, щоб неповний блок пішов вчасно
+    uint32_t maxWaitMs(uint32_t nowMs, uint32_t waitMs) const {
+        if (current == NULL || current->lines == 0) return waitMs;
+        uint32_t age = nowMs - current->createdMs;
+        uint32_t left = age < Cfg::blockFlushMs ? Cfg::blockFlushMs - age : 1;
+        return left < waitMs ? left : waitMs;
+    }
+
+    uint32_t linesLost() const { return lost; }
+
+private:
+    void lineLost() {
+        lost++;
+        TRACE_EVENT(TRACE_OVERFLOW, TRACE_OVF_BLOCK_POOL, 1);
+    }
+
+    LineBlockPool &pool;
+    SinkFanout &fanout;
+    LineBlock *current;          // Блок, який зараз заповнює обробник
+    uint32_t lost;               // Рядки, для яких не знайшлося вільного блоку
+};
+
+template <typename Cfg, typename Clock>
+class IngestPipeline {
+public:
+    typedef Cfg Config;
+
+    static_assert((Cfg::ringBytes & (Cfg::ringBytes - 1)) == 0, "ringBytes must be a power of two");
+    static_assert(Cfg::lineMaxLength + 64 < Cfg::blockBytes, "a full segment with its prefix must fit one block");
+    static_assert(Cfg::streams > 0, "at least one stream");
+
+    IngestPipeline(Clock &clock, LineBlockPool &pool, SinkFanout &fanout)
+        : clock(clock), out(pool, fanout), lastTelemetryFlushMs(0) {
+        for (int i = 0; i < Cfg::streams; i++) tags[i] = "";
+    }
+
+    static constexpr int streams() { return Cfg::streams; }
+
+    // Етапи, яких немає в збірці, повертають NULL - гілки для них компілятор відкидає.
+    // Проріджування і повтори - окремі для кожного потоку, налаштовувати всі
+    LineDecimator *decimator(int stream) {
+        if constexpr (Cfg::decimation) return &decimate[stream];
+        else return NULL;
+    }
+    TelemetryStore *telemetry() {
+        if constexpr (Cfg::telemetry) return &columns;
+        else return NULL;
+    }
+    LineDedup *dedup(int stream) {
+        if constexpr (Cfg::dedup) return &repeats[stream];
+        else return NULL;
+    }
+    BlockWriter<Cfg> &writer() { return out; }
+
+    // Початок пачки: свіжий timestamp і одна резервація блоку під очікувані байти
+    void beginBatch(size_t fillBytes, uint32_t maxLines) {
+        clock.refresh();
+        if (fillBytes > 0) out.reserve(fillBytes + (size_t)maxLines * (clock.length() + 1));
+    }
+
+    // Рядки кільця потоку stream, поки є ліміт і keepGoing(). Повертає кількість рядків;
+    // drained - повних рядків у кільці більше немає
+    template <typename KeepGoing>
+    uint32_t drain(int stream, ByteRing &ring, LineFramer &framer, const char *tag, uint32_t maxLines,
+                   KeepGoing &&keepGoing, bool &drained) {
+        setStream(stream, tag);
+        auto emit = [this, stream](const char *line, size_t len) { this->line(stream, line, len); };
+        uint32_t lines = 0;
+        while (lines < maxLines && keepGoing()) {
+            if (!framer.next(ring, emit)) {
+                // Незавершений рядок після тиші (prompt, дані без '\n')
+                framer.flushIdle(loggerMillis(), emit);
+                drained = true;
+                return lines;
+            }
+            lines++;
+        }
+        drained = false;
+        return lines;
+    }
+
+    // Пристрій відключився посеред рядка - віддаємо хвіст з маркером [CUT]
+    void finish(int stream, LineFramer &framer, const char *tag) {
+        setStream(stream, tag);
+        framer.finish([this, stream](const char *line, size_t len) { this->line(stream, line, len); });
+    }
+
+    // Один рядок потоку stream через усі зібрані етапи. Тег - від останнього drain()/setStream()
+    void line(int stream, const char *line, size_t len) {
+        uint32_t now = loggerMillis();
+        // Проріджування - першим, щоб відкинуті рядки не коштували нічого далі.
+        // Підсумки агрегації проходять решту конвеєра як звичайні рядки
+        if constexpr (Cfg::decimation) {
+            LineDecimator &d = decimate[stream];
+            if (d.isActive() &&
+                d.process(line, len, now, [this, stream, now](const char *l, size_t n) { undecimated(stream, l, n, now); })) {
+                return;
+            }
+        }
+        undecimated(stream, line, len, now);
+    }
+
+    // Тег потоку для його рядків; запам'ятовується для того, що потік видасть у poll()
+    void setStream(int stream, const char *tag) {
+        tags[stream] = tag;
+        clock.setTag(tag);
+    }
+
+    // Обслуговування між пачками: вікна агрегації, серії повторів, телеметрія, старий блок.
+    // true - блок відправлено
+    bool poll(uint32_t nowMs) {
+        if constexpr (Cfg::telemetry) {
+            // Неповні блоки телеметрії не тримаємо в RAM довше telemetryFlushMs;
+            // запит скидання (telemetry off) виконуємо навіть для вимкненого етапу
+            if (columns.takeFlushRequest() ||
+                (columns.isEnabled() && nowMs - lastTelemetryFlushMs >= Cfg::telemetryFlushMs)) {
+                columns.flush();
+                lastTelemetryFlushMs = nowMs;
+            }
+        }
+        if constexpr (Cfg::decimation || Cfg::dedup) {
+            for (int s = 0; s < Cfg::streams; s++) {
+                // Агрегат і підсумок ідуть з тегом свого потоку, а не останнього drain()
+                clock.setTag(tags[s]);
+                if constexpr (Cfg::decimation) {
+                    // Закриваємо вікна агрегації, що минули (і після "decim off")
+                    decimate[s].poll(nowMs, [this, s, nowMs](const char *l, size_t n) { undecimated(s, l, n, nowMs); });
+                }
+                if constexpr (Cfg::dedup) {
+                    // Підсумок серії повторів не затримуємо довше maxHoldMs
+                    repeats[s].poll(nowMs, [this](const char *p, size_t pn, const char *l, size_t n) { out.append(p, pn, l, n); });
+                }
+            }
+        }
+        return out.poll(nowMs);
+    }
+
+private:
+    void undecimated(int stream, const char *line, size_t len, uint32_t now) {
+        // Розпізнана телеметрія не потрапляє в текстовий лог
+        if constexpr (Cfg::telemetry) {
+            if (columns.isEnabled() && columns.append(line, len, clock.unixMs(now))) return;
+        }
+
+        // Секунда змінилась - переформатовуємо префікс (інакше використовуємо готовий)
+        clock.tick(now);
+        if constexpr (Cfg::dedup) {
+            repeats[stream].process(clock.prefix(), clock.length(), line, len, now,
+                            [this](const char *p, size_t pn, const char *l, size_t n) { out.append(p, pn, l, n); });
+        } else {
+            out.append(clock.prefix(), clock.length(), line, len);
+        }
+    }
+
+    Clock &clock;
+    BlockWriter<Cfg> out;
+    IngestStage<Cfg::decimation, LineDecimator> decimate[Cfg::streams];
+    IngestStage<Cfg::telemetry, TelemetryStore> columns;
+    IngestStage<Cfg::dedup, LineDedup> repeats[Cfg::streams];
+    const char *tags[Cfg::streams];   // Тег кожного потоку для рядків з poll()
+    uint32_t lastTelemetryFlushMs;
+};
+
+// Час від старту замість RTC: "[+12.345] " - для прогону на хості
+class UptimeClock {
+public:
+    UptimeClock() : startMs(loggerMillis()), stampLen(0), tagText(""), formattedMs(0), len(0) { buf[0] = '\0'; }
+
+    const char *prefix() const { return buf; }
+    size_t length() const { return len; }
+
+    void setTag(const char *tag) {
+        tagText = tag;
+        size_t tagLen = strnlen(tag, sizeof(buf) - 1 - stampLen);
+        memcpy(buf + stampLen, tag, tagLen);
+        len = stampLen + tagLen;
+        buf[len] = '\0';
+    }
+
+    void refresh() { format(loggerMillis()); }
+
+    // Мілісекунди в штампі - оновлюємо раз на мс, а не на кожен рядок
+    void tick(uint32_t nowMs) {
+        if (nowMs != formattedMs) format(nowMs);
+    }
+
+    uint64_t unixMs(uint32_t nowMs) const { return nowMs; }
+
+private:
+    void format(uint32_t nowMs) {
+        uint32_t upMs = nowMs - startMs;
+        int n = snprintf(buf, sizeof(buf), "[+%lu.%03lu] ", (unsigned long)(upMs / 1000), (unsigned long)(upMs % 1000));
+        stampLen = n < 0 ? 0 : (size_t)n < sizeof(buf) - 1 ? (size_t)n : sizeof(buf) - 1;
+        formattedMs = nowMs;
+        setTag(tagText);
+    }
+
+    uint32_t startMs;
+    char buf[48];
+    size_t stampLen;
+    const char *tagText;
+    uint32_t formattedMs;
+    size_t len;
+};
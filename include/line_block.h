@@ -0,0 +1,142 @@
+/*
+ * Спільні блоки рядків для розсилки по sink'ах.
+ *
+ * Обробник буфера складає готові рядки (з timestamp і '\n') у блок,
+ * а потім ОДИН і той самий блок потрапляє у черги всіх sink'ів.
+ * Кожен sink тримає посилання і відпускає його після запису - рядки
+ * не копіюються на кожен вихід. Коли лічильник посилань падає до нуля,
+ * блок повертається в пул. Пул фіксованого розміру - пам'ять обмежена.
+ */
+#pragma once
+
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include "logger_port.h"
+
+class LineBlockPool;
+
+struct LineBlock {
+    char *data;
+    uint32_t capacity;
+    uint32_t length;
+    uint32_t lines;
+    uint32_t createdMs;          // Коли в блок додано перший рядок
+    std::atomic<uint32_t> refs;
+    LineBlockPool *pool;
+
+    uint32_t freeSpace() const { return capacity - length; }
+
+    // Додає рядок + '\n'. false якщо не вміщається
+    bool appendLine(const char *line, size_t len) {
+        if (len + 1 > freeSpace()) return false;
+        memcpy(data + length, line, len);
+        length += len;
+        data[length++] = '\n';
+        lines++;
+        return true;
+    }
+
+    // Додає сирі байти (бінарні блоки телеметрії тощо)
+    bool append(const void *bytes, size_t len) {
+        if (len > freeSpace()) return false;
+        memcpy(data + length, bytes, len);
+        length += len;
+        return true;
+    }
+
+    // Додає рядок з префіксом ("[timestamp] ") без проміжних String
+    bool appendLine(const char *prefix, size_t prefixLen, const char *line, size_t len) {
+        if (prefixLen + len + 1 > freeSpace()) return false;
+        memcpy(data + length, prefix, prefixLen);
+        length += prefixLen;
+        return appendLine(line, len);
+    }
+
+    void retain() { refs.fetch_add(1, std::memory_order_relaxed); }
+    inline void release();
+};
+
+class LineBlockPool {
+public:
+    LineBlockPool() : blocks(NULL), storage(NULL), freeList(NULL),
+                      blockCount(0), freeCount(0), blockSize(0), exhaustedCount(0) {}
+    ~LineBlockPool() { end(); }
+
+    // Виділяє blockCount блоків по blockSize байт (на ESP32 - у PSRAM)
+    bool begin(size_t count, size_t size) {
+        end();
+        blocks = new LineBlock[count];
+        freeList = new LineBlock*[count];
+        storage = (char *)loggerAlloc(count * size);
+        if (storage == NULL) {
+            end();
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            blocks[i].data = storage + i * size;
+            blocks[i].capacity = size;
+            blocks[i].length = 0;
+            blocks[i].lines = 0;
+            blocks[i].createdMs = 0;
+            blocks[i].refs.store(0);
+            blocks[i].pool = this;
+            freeList[i] = &blocks[i];
+        }
+        blockCount = count;
+        freeCount = count;
+        blockSize = size;
+        return true;
+    }
+
+    void end() {
+        delete[] blocks;
+        delete[] freeList;
+        if (storage != NULL) loggerFree(storage);
+        blocks = NULL;
+        freeList = NULL;
+        storage = NULL;
+        blockCount = freeCount = 0;
+    }
+
+    // Порожній блок з одним посиланням (у того, хто його взяв), або NULL
+    LineBlock *acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeCount == 0) {
+            exhaustedCount++;
+            return NULL;
+        }
+        LineBlock *block = freeList[--freeCount];
+        block->length = 0;
+        block->lines = 0;
+        block->createdMs = loggerMillis();
+        block->refs.store(1, std::memory_order_relaxed);
+        return block;
+    }
+
+    void recycle(LineBlock *block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeList[freeCount++] = block;
+    }
+
+    size_t available() const { return freeCount; }
+    size_t size() const { return blockCount; }
+    size_t blockBytes() const { return blockSize; }
+    uint32_t exhausted() const { return exhaustedCount; }
+
+private:
+    LineBlock *blocks;
+    char *storage;
+    LineBlock **freeList;
+    size_t blockCount;
+    volatile size_t freeCount;
+    size_t blockSize;
+    uint32_t exhaustedCount;
+    std::mutex mutex;
+};
+
+inline void LineBlock::release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pool->recycle(this);
+    }
+}
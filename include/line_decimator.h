@@ -0,0 +1,251 @@
+/*
+ * Проріджування високочастотних числових потоків за префіксом рядка.
+ *
+ * Для кожного каналу (префікс/тег на початку рядка) - один режим:
+ *   EVERY_N   - пропускаємо кожен N-й рядок;
+ *   INTERVAL  - не частіше одного рядка за intervalMs;
+ *   AGGREGATE - замість рядків за вікно один підсумок
+ *               "<prefix>agg n=K min=[..] max=[..] mean=[..]"
+ *               по всіх числових полях рядка (mean кожного поля - по
+ *               рядках вікна, в яких це поле було).
+ * Без виділення пам'яті: стан вікна - фіксовані масиви в правилі.
+ * passthrough вмикає повну швидкість без перезапуску.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "logger_port.h"
+
+#define DECIM_MAX_RULES 8
+#define DECIM_MAX_PREFIX 16
+#define DECIM_MAX_FIELDS 8
+#define DECIM_DECIMALS 3           // Агрегати рахуються з фіксованою комою: 3 знаки
+#define DECIM_SCALE 1000
+
+enum class DecimationMode : uint8_t { EVERY_N, INTERVAL, AGGREGATE };
+
+struct DecimationRule {
+    const char *prefix;
+    DecimationMode mode;
+    uint32_t param;            // N для EVERY_N, мс для INTERVAL і AGGREGATE
+};
+
+struct DecimationStats {
+    uint32_t linesIn;          // Рядки, що відповідали правилам
+    uint32_t linesPassed;
+    uint32_t aggregates;
+};
+
+class LineDecimator {
+public:
+    LineDecimator() : ruleCount(0), passthrough(false) { memset(&st, 0, sizeof(st)); }
+
+    bool addRule(const DecimationRule &rule) {
+        size_t len = strlen(rule.prefix);
+        if (ruleCount >= DECIM_MAX_RULES || len == 0 || len >= DECIM_MAX_PREFIX) return false;
+        if (rule.param == 0) return false;
+        Rule &r = rules[ruleCount++];
+        memcpy(r.prefix, rule.prefix, len + 1);
+        r.prefixLen = len;
+        r.mode = rule.mode;
+        r.param = rule.param;
+        r.counter = 0;
+        r.lastMs = 0;
+        r.hasLast = false;
+        r.windowCount = 0;
+        return true;
+    }
+
+    int count() const { return ruleCount; }
+    const char *rulePrefix(int i) const { return rules[i].prefix; }
+    DecimationMode ruleMode(int i) const { return rules[i].mode; }
+    uint32_t ruleParam(int i) const { return rules[i].param; }
+
+    // Повна швидкість без проріджування - безпечно з іншого потоку
+    void setPassthrough(bool on) { passthrough.store(on); }
+    bool isPassthrough() const { return passthrough.load(); }
+    bool isActive() const { return ruleCount > 0 && !passthrough.load(); }
+
+    const DecimationStats &stats() const { return st; }
+    void resetStats() { memset(&st, 0, sizeof(st)); }
+
+    // true - рядок поглинуто (відкинуто або додано в агрегат), далі його не передавати.
+    // emit(line, len) отримує готові підсумки агрегації
+    template <typename Emit>
+    bool process(const char *line, size_t len, uint32_t nowMs, Emit &&emit) {
+        if (!isActive()) return false;
+
+        for (int i = 0; i < ruleCount; i++) {
+            Rule &r = rules[i];
+            if (len < r.prefixLen || memcmp(line, r.prefix, r.prefixLen) != 0) continue;
+            st.linesIn++;
+
+            switch (r.mode) {
+                case DecimationMode::EVERY_N: {
+                    bool pass = (r.counter == 0);
+                    r.counter = (r.counter + 1) % r.param;
+                    if (pass) st.linesPassed++;
+                    return !pass;
+                }
+                case DecimationMode::INTERVAL: {
+                    if (!r.hasLast || nowMs - r.lastMs >= r.param) {
+                        r.lastMs = nowMs;
+                        r.hasLast = true;
+                        st.linesPassed++;
+                        return false;
+                    }
+                    return true;
+                }
+                case DecimationMode::AGGREGATE: {
+                    if (r.windowCount > 0 && nowMs - r.lastMs >= r.param) {
+                        emitAggregate(r, emit);
+                    }
+                    if (r.windowCount == 0) r.lastMs = nowMs;
+                    accumulate(r, line + r.prefixLen, len - r.prefixLen);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Закриває вікна агрегації, що вже минули (викликати періодично)
+    template <typename Emit>
+    void poll(uint32_t nowMs, Emit &&emit) {
+        for (int i = 0; i < ruleCount; i++) {
+            Rule &r = rules[i];
+            if (r.mode == DecimationMode::AGGREGATE && r.windowCount > 0 && nowMs - r.lastMs >= r.param) {
+                emitAggregate(r, emit);
+            }
+        }
+    }
+
+    // Віддає всі незакриті агрегати (перед вимкненням проріджування)
+    template <typename Emit>
+    void flush(Emit &&emit) {
+        for (int i = 0; i < ruleCount; i++) {
+            if (rules[i].mode == DecimationMode::AGGREGATE && rules[i].windowCount > 0) {
+                emitAggregate(rules[i], emit);
+            }
+        }
+    }
+
+private:
+    struct Rule {
+        char prefix[DECIM_MAX_PREFIX];
+        size_t prefixLen;
+        DecimationMode mode;
+        uint32_t param;
+        uint32_t counter;
+        uint32_t lastMs;       // INTERVAL - останній пропущений, AGGREGATE - початок вікна
+        bool hasLast;
+        uint32_t windowCount;
+        uint8_t fieldCount;
+        int64_t minV[DECIM_MAX_FIELDS];
+        int64_t maxV[DECIM_MAX_FIELDS];
+        int64_t sum[DECIM_MAX_FIELDS];
+        uint32_t fieldN[DECIM_MAX_FIELDS];   // У скількох рядках вікна було поле
+    };
+
+    // Знаходить числа в рядку і додає їх у вікно (значення * DECIM_SCALE)
+    void accumulate(Rule &r, const char *p, size_t len) {
+        const char *start = p;
+        const char *end = p + len;
+        uint8_t field = 0;
+        while (p < end && field < DECIM_MAX_FIELDS) {
+            // Число: [-]цифри[.цифри], перед ним не буква (щоб "ch2" не давало 2)
+            char ch = *p;
+            char prev = p > start ? p[-1] : ' ';
+            bool afterLetter = (prev >= 'a' && prev <= 'z') || (prev >= 'A' && prev <= 'Z') || prev == '_';
+            bool startsNumber = !afterLetter &&
+                                ((ch >= '0' && ch <= '9') ||
+                                 (ch == '-' && p + 1 < end && p[1] >= '0' && p[1] <= '9'));
+            if (!startsNumber) {
+                p++;
+                continue;
+            }
+
+            bool negative = (ch == '-');
+            if (negative) p++;
+            int64_t value = 0;
+            while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+            int frac = 0;
+            if (p < end && *p == '.') {
+                p++;
+                while (p < end && *p >= '0' && *p <= '9') {
+                    if (frac < DECIM_DECIMALS) {
+                        value = value * 10 + (*p - '0');
+                        frac++;
+                    }
+                    p++;
+                }
+            }
+            for (; frac < DECIM_DECIMALS; frac++) value *= 10;
+            if (negative) value = -value;
+
+            if (r.windowCount == 0 || field >= r.fieldCount) {
+                r.minV[field] = r.maxV[field] = value;
+                r.sum[field] = 0;
+                r.fieldN[field] = 0;
+            }
+            if (value < r.minV[field]) r.minV[field] = value;
+            if (value > r.maxV[field]) r.maxV[field] = value;
+            r.sum[field] += value;
+            r.fieldN[field]++;
+            field++;
+
+            // Пропускаємо решту "слова" (одиниці виміру тощо)
+            while (p < end && *p != ' ' && *p != ',' && *p != ';' && *p != '\t' && *p != '=') p++;
+        }
+        if (r.windowCount == 0 || field > r.fieldCount) r.fieldCount = field;
+        r.windowCount++;
+    }
+
+    static size_t appendFixed(char *buf, size_t cap, size_t n, int64_t value) {
+        if (n >= cap) return n;
+        const char *sign = value < 0 ? "-" : "";
+        uint64_t v = value < 0 ? (uint64_t)(-value) : (uint64_t)value;
+        int w = snprintf(buf + n, cap - n, "%s%llu.%03u", sign,
+                         (unsigned long long)(v / DECIM_SCALE), (unsigned)(v % DECIM_SCALE));
+        return w > 0 ? n + w : n;
+    }
+
+    static size_t appendList(char *buf, size_t cap, size_t n, const char *name,
+                             const int64_t *values, uint8_t count, const uint32_t *divisors) {
+        int w = snprintf(buf + n, n < cap ? cap - n : 0, " %s=[", name);
+        if (w > 0) n += w;
+        for (uint8_t f = 0; f < count; f++) {
+            if (f > 0 && n < cap) buf[n++] = ',';
+            n = appendFixed(buf, cap, n, divisors != NULL ? values[f] / (int64_t)divisors[f] : values[f]);
+        }
+        if (n < cap) buf[n++] = ']';
+        return n;
+    }
+
+    template <typename Emit>
+    void emitAggregate(Rule &r, Emit &&emit) {
+        char buf[DECIM_MAX_PREFIX + 40 + 3 * DECIM_MAX_FIELDS * 24];
+        size_t cap = sizeof(buf);
+        size_t n = 0;
+        memcpy(buf, r.prefix, r.prefixLen);
+        n += r.prefixLen;
+        int w = snprintf(buf + n, cap - n, "agg n=%u", (unsigned)r.windowCount);
+        if (w > 0) n += w;
+
+        n = appendList(buf, cap, n, "min", r.minV, r.fieldCount, NULL);
+        n = appendList(buf, cap, n, "max", r.maxV, r.fieldCount, NULL);
+        n = appendList(buf, cap, n, "mean", r.sum, r.fieldCount, r.fieldN);
+        if (n > cap) n = cap;
+
+        st.aggregates++;
+        r.windowCount = 0;
+        emit(buf, n);
+    }
+
+    Rule rules[DECIM_MAX_RULES];
+    int ruleCount;
+    std::atomic<bool> passthrough;
+    DecimationStats st;
+};
@@ -0,0 +1,209 @@
+/*
+ * Згортання повторюваних рядків (heartbeat, статуси) перед записом.
+ *
+ * Перший рядок серії проходить як є, усі однакові повтори за ним
+ * замінюються одним підсумком:
+ *     [t2] repeated N times between [t1] and [t2]
+ * У режимі fuzzy рядки, що відрізняються тільки числами, теж
+ * вважаються повтором (числа замінюються на '#' при хешуванні).
+ *
+ * Пам'ять фіксована (копія еталонного рядка до DEDUP_MAX_LINE байт),
+ * затримка обмежена: підсумок виходить не пізніше maxHoldMs після
+ * першого придушеного повтору, навіть якщо серія ще триває.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "logger_port.h"
+
+#define DEDUP_MAX_LINE 256     // Скільки байт еталонного рядка зберігаємо для точного порівняння
+#define DEDUP_MAX_STAMP 32     // Максимальна довжина timestamp-префікса
+
+struct DedupStats {
+    uint32_t linesIn;
+    uint32_t linesSuppressed;
+    uint32_t summaries;
+    uint32_t bytesSuppressed;  // Байти придушених рядків разом з префіксами
+    uint32_t summaryBytes;     // Байти, які додали підсумки
+};
+
+class LineDedup {
+public:
+    LineDedup() : enabled(false), fuzzy(false), maxHoldMs(10000), request(0) { reset(); }
+
+    // Початкові налаштування - до запуску потоку, що викликає process()
+    void configure(bool on, bool fuzzyNumbers, uint32_t holdMs) {
+        enabled = on;
+        fuzzy = fuzzyNumbers;
+        maxHoldMs = holdMs;
+        refValid = false;
+        runCount = 0;
+    }
+
+    // Зміна режиму з іншого потоку: застосовує потік process()/poll(),
+    // спершу видавши підсумок відкритої серії
+    void requestMode(bool on, bool fuzzyNumbers) {
+        request.store(MODE_REQUESTED | (on ? MODE_ON : 0) | (fuzzyNumbers ? MODE_FUZZY : 0));
+    }
+
+    bool isEnabled() const { return enabled; }
+    bool isFuzzy() const { return fuzzy; }
+    uint32_t holdMs() const { return maxHoldMs; }
+    const DedupStats &stats() const { return st; }
+
+    // Економія з урахуванням доданих підсумків
+    int32_t bytesSaved() const { return (int32_t)st.bytesSuppressed - (int32_t)st.summaryBytes; }
+
+    void reset() {
+        memset(&st, 0, sizeof(st));
+        refValid = false;
+        runCount = 0;
+        refLen = 0;
+        refHash = 0;
+    }
+
+    // Пропускає рядок через дедуплікатор.
+    // emit(prefix, prefixLen, line, lineLen) викликається для рядків, які треба записати
+    template <typename Emit>
+    void process(const char *prefix, size_t prefixLen, const char *line, size_t len,
+                 uint32_t nowMs, Emit &&emit) {
+        applyRequest(emit);
+        if (!enabled) {
+            emit(prefix, prefixLen, line, len);
+            return;
+        }
+        st.linesIn++;
+
+        uint64_t hash = lineHash(line, len);
+        if (refValid && matches(hash, line, len)) {
+            if (runCount == 0) {
+                copyStamp(firstStamp, prefix, prefixLen);
+                runStartMs = nowMs;
+            }
+            copyStamp(lastStamp, prefix, prefixLen);
+            runCount++;
+            st.linesSuppressed++;
+            st.bytesSuppressed += prefixLen + len + 1;
+            poll(nowMs, emit);
+            return;
+        }
+
+        // Інший рядок - закриваємо серію і робимо його новим еталоном
+        flush(emit);
+        refValid = true;
+        refHash = hash;
+        refLen = len;
+        memcpy(refLine, line, len < DEDUP_MAX_LINE ? len : DEDUP_MAX_LINE);
+        emit(prefix, prefixLen, line, len);
+    }
+
+    // Обмежує затримку: підсумок серії не чекає довше maxHoldMs
+    template <typename Emit>
+    void poll(uint32_t nowMs, Emit &&emit) {
+        applyRequest(emit);
+        if (runCount > 0 && nowMs - runStartMs >= maxHoldMs) {
+            flush(emit);
+        }
+    }
+
+    // Видає підсумок поточної серії (якщо є). Еталон лишається - серія може продовжитись
+    template <typename Emit>
+    void flush(Emit &&emit) {
+        if (runCount == 0) return;
+
+        // Префікс - timestamp останнього повтору (з пробілом, як у рядків)
+        char prefix[DEDUP_MAX_STAMP + 2];
+        size_t prefixLen = strlen(lastStamp);
+        memcpy(prefix, lastStamp, prefixLen);
+        prefix[prefixLen++] = ' ';
+
+        // Один точний повтор коротший за підсумок - віддаємо його як є
+        if (runCount == 1 && !fuzzy && refLen <= DEDUP_MAX_LINE) {
+            st.linesSuppressed--;
+            st.bytesSuppressed -= prefixLen + refLen + 1;
+            runCount = 0;
+            emit(prefix, prefixLen, refLine, refLen);
+            return;
+        }
+
+        char summary[2 * DEDUP_MAX_STAMP + 64];
+        int n = snprintf(summary, sizeof(summary), "repeated %u times between %s and %s",
+                         (unsigned)runCount, firstStamp, lastStamp);
+        if (n < 0) n = 0;
+        if ((size_t)n >= sizeof(summary)) n = sizeof(summary) - 1;
+
+        st.summaries++;
+        st.summaryBytes += prefixLen + n + 1;
+        runCount = 0;
+        emit(prefix, prefixLen, summary, (size_t)n);
+    }
+
+private:
+    enum : uint8_t { MODE_REQUESTED = 1, MODE_ON = 2, MODE_FUZZY = 4 };
+
+    template <typename Emit>
+    void applyRequest(Emit &&emit) {
+        if (request.load(std::memory_order_relaxed) == 0) return;
+        uint8_t mode = request.exchange(0);
+        // Серія, зібрана в старому режимі, не повинна зникнути
+        flush(emit);
+        enabled = (mode & MODE_ON) != 0;
+        fuzzy = (mode & MODE_FUZZY) != 0;
+        refValid = false;
+    }
+
+    // FNV-1a 64 по рядку; у fuzzy режимі кожна група цифр хешується як один '#'
+    uint64_t lineHash(const char *line, size_t len) const {
+        uint64_t h = 1469598103934665603ULL;
+        bool inNumber = false;
+        for (size_t i = 0; i < len; i++) {
+            char ch = line[i];
+            if (fuzzy && ch >= '0' && ch <= '9') {
+                if (inNumber) continue;
+                inNumber = true;
+                ch = '#';
+            } else {
+                inNumber = false;
+            }
+            h ^= (uint8_t)ch;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    bool matches(uint64_t hash, const char *line, size_t len) const {
+        if (hash != refHash) return false;
+        if (fuzzy) return true;
+        if (len != refLen) return false;
+        // Короткі рядки порівнюємо побайтно, довгі - хеш + довжина + початок
+        size_t n = len < DEDUP_MAX_LINE ? len : DEDUP_MAX_LINE;
+        return memcmp(line, refLine, n) == 0;
+    }
+
+    // Зберігає timestamp без завершального пробілу
+    static void copyStamp(char *dst, const char *prefix, size_t prefixLen) {
+        while (prefixLen > 0 && prefix[prefixLen - 1] == ' ') prefixLen--;
+        if (prefixLen >= DEDUP_MAX_STAMP) prefixLen = DEDUP_MAX_STAMP - 1;
+        memcpy(dst, prefix, prefixLen);
+        dst[prefixLen] = '\0';
+    }
+
+    bool enabled;
+    bool fuzzy;
+    uint32_t maxHoldMs;
+    std::atomic<uint8_t> request;   // Режим від requestMode(), 0 - немає запиту
+
+    bool refValid;
+    uint64_t refHash;
+    size_t refLen;
+    char refLine[DEDUP_MAX_LINE];
+
+    uint32_t runCount;
+    uint32_t runStartMs;
+    char firstStamp[DEDUP_MAX_STAMP];
+    char lastStamp[DEDUP_MAX_STAMP];
+
+    DedupStats st;
+};
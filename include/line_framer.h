@@ -0,0 +1,197 @@
+/*
+ * Нарізка потоку байт з ByteRing на рядки.
+ *
+ * Рядок, що цілком лежить у неперервній частині кільця, віддається
+ * прямо з пам'яті кільця без копіювання. Копія в буфер рядка
+ * потрібна тільки коли рядок перетинає кінець кільця або приходить
+ * частинами з кількох USB transfer'ів.
+ *
+ * Пам'ять обмежена: рядок довший за maxLineLength (бінарні дані,
+ * hex-дампи, пристрій без '\n') віддається сегментами з маркерами:
+ *     <початок> [...]
+ *     [...] <продовження> [...]
+ *     [...] <кінець>
+ * Незавершений рядок можна також віддати після тиші (idle flush)
+ * або при відключенні пристрою (маркер [CUT]).
+ */
+#pragma once
+
+#include <string.h>
+#include <atomic>
+#include "byte_ring.h"
+
+#define LINE_CONT_PREFIX "[...] "   // Сегмент продовжує попередній
+#define LINE_CONT_SUFFIX " [...]"   // Рядок продовжується в наступному сегменті
+#define LINE_CUT_SUFFIX " [CUT]"    // Рядок обірвано (пристрій відключився)
+#define LINE_MARKER_ROOM 16         // Місце під маркери в буфері framer'а
+
+// Розмір буфера framer'а для рядків/сегментів до maxLen байт
+#define LINE_FRAMER_BUFFER_SIZE(maxLen) ((maxLen) + 2 * LINE_MARKER_ROOM)
+
+struct FramerStats {
+    uint32_t lines;
+    uint32_t bytes;
+    uint32_t zeroCopyLines;   // Рядки, віддані прямо з кільця
+    uint32_t segments;        // Незавершені сегменти довгих рядків
+    uint32_t idleFlushes;     // Сегменти, віддані через тишу на лінії
+    uint32_t cutLines;        // Рядки, обірвані відключенням
+};
+
+class LineFramer {
+public:
+    LineFramer(char *buffer, size_t bufferSize)
+        : data(buffer + LINE_MARKER_ROOM),
+          capacity(bufferSize - 2 * LINE_MARKER_ROOM), maxLen(capacity),
+          used(0), continuing(false), maxLenRequest(0), idleFlushMs(0), lastDataMs(0) {
+        memset(&st, 0, sizeof(st));
+    }
+
+    // Після скількох байт без '\n' віддавати сегмент (не більше розміру буфера).
+    // Тільки з потоку next(); з інших - requestMaxLineLength()
+    void setMaxLineLength(size_t len) { maxLen = clampLength(len); }
+    size_t maxLineLength() const { return maxLen; }
+
+    // Зміна ліміту з іншого потоку: застосовує наступний next().
+    // Повертає ліміт, який буде встановлено
+    size_t requestMaxLineLength(size_t len) {
+        len = clampLength(len);
+        maxLenRequest.store(len);
+        return len;
+    }
+
+    // Через скільки мс тиші віддавати незавершений рядок (0 - ніколи) - безпечно з іншого потоку
+    void setIdleFlushMs(uint32_t ms) { idleFlushMs.store(ms); }
+    uint32_t idleFlush() const { return idleFlushMs.load(); }
+
+    size_t pending() const { return used; }
+    const FramerStats &stats() const { return st; }
+    void resetStats() { memset(&st, 0, sizeof(st)); }
+    void reset() {
+        used = 0;
+        continuing = false;
+    }
+
+    // Читає з кільця до першого рядка або сегмента. emit(line, len).
+    // false - повних рядків більше немає (неповний хвіст лишається в буфері)
+    template <typename Emit>
+    bool next(ByteRing &ring, Emit &&emit) {
+        if (maxLenRequest.load(std::memory_order_relaxed) != 0) maxLen = maxLenRequest.exchange(0);
+        while (true) {
+            const uint8_t *p;
+            size_t n = ring.peek(&p);
+            if (n == 0) return false;
+            lastDataMs = loggerMillis();
+
+            const uint8_t *nl = (const uint8_t *)memchr(p, '\n', n);
+            size_t take = nl != NULL ? (size_t)(nl - p) : n;
+
+            // Найчастіший випадок - цілий короткий рядок у кільці, копіювати не треба
+            if (nl != NULL && used == 0 && !continuing && take <= maxLen) {
+                bool emitted = deliver((const char *)p, take, emit);
+                if (emitted) st.zeroCopyLines++;
+                ring.consume(take + 1);
+                if (emitted) return true;
+                continue;
+            }
+
+            // Ліміт могли зменшити, поки в буфері вже більше - тоді сегмент із того, що є
+            size_t room = used < maxLen ? maxLen - used : 0;
+            if (take > room) {
+                // Рядок довший за ліміт - віддаємо сегмент, пам'ять не росте
+                memcpy(data + used, p, room);
+                used += room;
+                ring.consume(room);
+                st.segments++;
+                emitSegment(LINE_CONT_SUFFIX, true, emit);
+                return true;
+            }
+
+            memcpy(data + used, p, take);
+            used += take;
+            if (nl == NULL) {
+                ring.consume(take);
+                continue;
+            }
+
+            ring.consume(take + 1);
+            if (emitSegment("", false, emit)) return true;
+        }
+    }
+
+    // Віддає незавершений рядок після idleFlushMs тиші (prompt'и, дані без '\n')
+    template <typename Emit>
+    bool flushIdle(uint32_t nowMs, Emit &&emit) {
+        uint32_t idleMs = idleFlushMs.load(std::memory_order_relaxed);
+        if (idleMs == 0 || used == 0) return false;
+        if (nowMs - lastDataMs < idleMs) return false;
+        st.idleFlushes++;
+        return emitSegment(LINE_CONT_SUFFIX, true, emit);
+    }
+
+    // Потік закінчився (відключення) - віддаємо хвіст з маркером обриву
+    template <typename Emit>
+    bool finish(Emit &&emit) {
+        if (used == 0 && !continuing) return false;
+        st.cutLines++;
+        return emitSegment(LINE_CUT_SUFFIX, false, emit);
+    }
+
+private:
+    size_t clampLength(size_t len) const {
+        if (len < 16) len = 16;
+        return len < capacity ? len : capacity;
+    }
+
+    // Прибирає '\r' в кінці, порожні рядки пропускає
+    template <typename Emit>
+    bool deliver(const char *line, size_t len, Emit &&emit) {
+        while (len > 0 && line[len - 1] == '\r') len--;
+        if (len == 0) return false;
+        st.lines++;
+        st.bytes += len;
+        emit(line, len);
+        return true;
+    }
+
+    // Віддає вміст буфера з маркерами продовження. continues - буде ще сегмент
+    template <typename Emit>
+    bool emitSegment(const char *suffix, bool continues, Emit &&emit) {
+        size_t len = used;
+        if (!continues) {
+            while (len > 0 && data[len - 1] == '\r') len--;
+        }
+        if (len == 0 && !continuing) {
+            used = 0;
+            return false;
+        }
+
+        char *start = data;
+        size_t total = len;
+        if (continuing) {
+            size_t prefixLen = sizeof(LINE_CONT_PREFIX) - 1;
+            start -= prefixLen;
+            memcpy(start, LINE_CONT_PREFIX, prefixLen);
+            total += prefixLen;
+        }
+        size_t suffixLen = strlen(suffix);
+        memcpy(start + total, suffix, suffixLen);
+        total += suffixLen;
+
+        continuing = continues;
+        used = 0;
+        if (!continues) st.lines++;
+        st.bytes += len;
+        emit((const char *)start, total);
+        return true;
+    }
+
+    char *data;          // Дані рядка; перед ними і після них - місце під маркери
+    size_t capacity;
+    size_t maxLen;
+    size_t used;
+    bool continuing;     // Наступний сегмент продовжує вже відданий
+    std::atomic<size_t> maxLenRequest;   // Від requestMaxLineLength(), 0 - немає запиту
+    std::atomic<uint32_t> idleFlushMs;
+    uint32_t lastDataMs;
+    FramerStats st;
+};
@@ -0,0 +1,373 @@
+/*
+ * Sink'и логера і розсилка блоків рядків по них.
+ *
+ * Кожен вихід (SD, Serial, файл/пам'ять на хості) реалізує LogSink і
+ * отримує ВЛАСНУ обмежену чергу спільних LineBlock. Повільний sink
+ * переповнює тільки свою чергу і діє за своєю політикою - решта
+ * виходів продовжують працювати на повній швидкості.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <atomic>
+#include "line_block.h"
+#include "trace.h"
+
+#define MAX_SINKS 4
+#define MAX_SINK_QUEUE_DEPTH 32
+
+// Що робити коли черга sink'а заповнена
+enum class OverflowPolicy : uint8_t {
+    DROP_NEWEST,  // Відкидаємо новий блок (зберігаємо початок події)
+    DROP_OLDEST,  // Витісняємо найстаріший (зберігаємо свіжі дані)
+    BLOCK         // Чекаємо звільнення місця, але не довше blockTimeoutMs
+};
+
+inline const char *overflowPolicyName(OverflowPolicy policy) {
+    switch (policy) {
+        case OverflowPolicy::DROP_NEWEST: return "drop-newest";
+        case OverflowPolicy::DROP_OLDEST: return "drop-oldest";
+        case OverflowPolicy::BLOCK: return "block";
+    }
+    return "?";
+}
+
+struct SinkMetrics {
+    uint32_t blocksQueued;
+    uint32_t blocksWritten;
+    uint32_t blocksDropped;
+    uint32_t linesWritten;
+    uint32_t linesDropped;
+    uint32_t bytesWritten;
+    uint32_t bytesDropped;
+    uint32_t writeErrors;
+    uint32_t maxDepth;
+    uint32_t writeTimeUs;  // Сумарний час у write()
+    uint32_t maxWriteUs;   // Найдовший одиночний write()
+    uint32_t blockedUs;    // Скільки продюсер чекав через BLOCK
+};
+
+// Лічильники одного sink'а: продюсер (enqueue), потік sink'а (service) і команди
+// з loop() (setEnabled, скидання) пишуть їх з різних ядер, тому кожне поле атомарне.
+// Назовні віддається копія SinkMetrics
+class SinkCounters {
+public:
+    SinkCounters() { reset(); }
+
+    // Максимум, який можуть піднімати кілька потоків одночасно
+    static void raise(std::atomic<uint32_t> &max, uint32_t v) {
+        uint32_t cur = max.load(std::memory_order_relaxed);
+        while (v > cur && !max.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+    }
+
+    SinkMetrics snapshot() const {
+        SinkMetrics m;
+        m.blocksQueued = blocksQueued.load(std::memory_order_relaxed);
+        m.blocksWritten = blocksWritten.load(std::memory_order_relaxed);
+        m.blocksDropped = blocksDropped.load(std::memory_order_relaxed);
+        m.linesWritten = linesWritten.load(std::memory_order_relaxed);
+        m.linesDropped = linesDropped.load(std::memory_order_relaxed);
+        m.bytesWritten = bytesWritten.load(std::memory_order_relaxed);
+        m.bytesDropped = bytesDropped.load(std::memory_order_relaxed);
+        m.writeErrors = writeErrors.load(std::memory_order_relaxed);
+        m.maxDepth = maxDepth.load(std::memory_order_relaxed);
+        m.writeTimeUs = writeTimeUs.load(std::memory_order_relaxed);
+        m.maxWriteUs = maxWriteUs.load(std::memory_order_relaxed);
+        m.blockedUs = blockedUs.load(std::memory_order_relaxed);
+        return m;
+    }
+
+    void reset() {
+        blocksQueued = 0;
+        blocksWritten = 0;
+        blocksDropped = 0;
+        linesWritten = 0;
+        linesDropped = 0;
+        bytesWritten = 0;
+        bytesDropped = 0;
+        writeErrors = 0;
+        maxDepth = 0;
+        writeTimeUs = 0;
+        maxWriteUs = 0;
+        blockedUs = 0;
+    }
+
+    std::atomic<uint32_t> blocksQueued;
+    std::atomic<uint32_t> blocksWritten;
+    std::atomic<uint32_t> blocksDropped;
+    std::atomic<uint32_t> linesWritten;
+    std::atomic<uint32_t> linesDropped;
+    std::atomic<uint32_t> bytesWritten;
+    std::atomic<uint32_t> bytesDropped;
+    std::atomic<uint32_t> writeErrors;
+    std::atomic<uint32_t> maxDepth;
+    std::atomic<uint32_t> writeTimeUs;
+    std::atomic<uint32_t> maxWriteUs;
+    std::atomic<uint32_t> blockedUs;
+};
+
+class LogSink {
+public:
+    virtual ~LogSink() {}
+    virtual const char *name() const = 0;
+    // Записує весь блок. false - помилка запису (блок рахується втраченим)
+    virtual bool write(const LineBlock &block) = 0;
+    // Викликається після пачки write() - закрити/скинути файл тощо
+    virtual void flush() {}
+    // Викликається потоком sink'а на кожному обслуговуванні, навіть без даних
+    virtual void poll(uint32_t nowMs) { (void)nowMs; }
+};
+
+// Обмежена кільцева черга вказівників на блоки одного sink'а
+class SinkQueue {
+public:
+    SinkQueue() : head(0), tail(0), count(0), depth(0) {}
+
+    void setDepth(size_t d) { depth = d < MAX_SINK_QUEUE_DEPTH ? d : MAX_SINK_QUEUE_DEPTH; }
+    size_t capacity() const { return depth; }
+    size_t size() const { return count; }
+    bool full() const { return count >= depth; }
+
+    bool push(LineBlock *block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count >= depth) return false;
+        slots[tail] = block;
+        tail = (tail + 1) % depth;
+        count++;
+        return true;
+    }
+
+    LineBlock *pop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count == 0) return NULL;
+        LineBlock *block = slots[head];
+        head = (head + 1) % depth;
+        count--;
+        return block;
+    }
+
+    // Для DROP_OLDEST: атомарно витісняє найстаріший і ставить новий
+    LineBlock *replaceOldest(LineBlock *block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        LineBlock *evicted = NULL;
+        if (count >= depth) {
+            evicted = slots[head];
+            head = (head + 1) % depth;
+            count--;
+        }
+        slots[tail] = block;
+        tail = (tail + 1) % depth;
+        count++;
+        return evicted;
+    }
+
+private:
+    LineBlock *slots[MAX_SINK_QUEUE_DEPTH];
+    size_t head;
+    size_t tail;
+    std::atomic<size_t> count;   // size() читають без блокування з інших потоків
+    size_t depth;
+    std::mutex mutex;
+};
+
+// Розсилка блоків: продюсер викликає publish(), кожен sink обслуговується
+// своїм потоком через service(index)
+class SinkFanout {
+public:
+    SinkFanout() : sinkCount(0) {}
+
+    // Повертає індекс sink'а або -1 якщо місць немає
+    int add(LogSink *sink, size_t depth, OverflowPolicy policy, uint32_t blockTimeoutMs = 0) {
+        if (sinkCount >= MAX_SINKS || sink == NULL) return -1;
+        Slot &slot = slots[sinkCount];
+        slot.sink = sink;
+        slot.policy = policy;
+        slot.blockTimeoutMs = blockTimeoutMs;
+        slot.enabled.store(true);
+        slot.queue.setDepth(depth);
+        slot.metrics.reset();
+        return sinkCount++;
+    }
+
+    // Віддає блок усім увімкненим sink'ам і забирає посилання продюсера
+    void publish(LineBlock *block) {
+        if (block == NULL) return;
+        for (int i = 0; i < sinkCount; i++) {
+            Slot &slot = slots[i];
+            if (!slot.enabled.load()) continue;
+            block->retain();
+            enqueue(slot, block);
+        }
+        block->release();
+    }
+
+    // Записує до maxBlocks блоків із черги sink'а. Повертає кількість записаних
+    uint32_t service(int index, uint32_t maxBlocks = MAX_SINK_QUEUE_DEPTH) {
+        if (index < 0 || index >= sinkCount) return 0;
+        Slot &slot = slots[index];
+        uint32_t written = 0;
+        while (written < maxBlocks) {
+            LineBlock *block = slot.queue.pop();
+            if (block == NULL) break;
+
+            uint32_t t1 = loggerMicros();
+            bool ok = slot.sink->write(*block);
+            uint32_t dt = loggerMicros() - t1;
+
+            slot.metrics.writeTimeUs += dt;
+            SinkCounters::raise(slot.metrics.maxWriteUs, dt);
+            if (ok) {
+                slot.metrics.blocksWritten++;
+                slot.metrics.linesWritten += block->lines;
+                slot.metrics.bytesWritten += block->length;
+            } else {
+                slot.metrics.writeErrors++;
+                countDrop(slot, block);
+            }
+            block->release();
+            written++;
+        }
+        if (written > 0) slot.sink->flush();
+        if (slot.enabled.load()) slot.sink->poll(loggerMillis());
+        return written;
+    }
+
+    void setEnabled(int index, bool enabled) {
+        if (index < 0 || index >= sinkCount) return;
+        slots[index].enabled.store(enabled);
+        if (!enabled) {
+            // Вимкнений sink не повинен тримати блоки пулу
+            LineBlock *block;
+            while ((block = slots[index].queue.pop()) != NULL) {
+                countDrop(slots[index], block);
+                block->release();
+            }
+        }
+    }
+
+    bool enabled(int index) const { return index >= 0 && index < sinkCount && slots[index].enabled.load(); }
+    int count() const { return sinkCount; }
+    LogSink *sink(int index) const { return slots[index].sink; }
+    OverflowPolicy policy(int index) const { return slots[index].policy; }
+    size_t queued(int index) const { return slots[index].queue.size(); }
+    size_t depth(int index) const { return slots[index].queue.capacity(); }
+    // Копія лічильників: поля читаються окремо, тож між ними можуть проскочити свіжі події
+    SinkMetrics metrics(int index) const { return slots[index].metrics.snapshot(); }
+    void resetMetrics(int index) { slots[index].metrics.reset(); }
+
+private:
+    struct Slot {
+        LogSink *sink;
+        OverflowPolicy policy;
+        uint32_t blockTimeoutMs;
+        std::atomic<bool> enabled;   // Пише loop(), читають продюсер і потік sink'а
+        SinkQueue queue;
+        SinkCounters metrics;
+    };
+
+    void countDrop(Slot &slot, LineBlock *block) {
+        slot.metrics.blocksDropped++;
+        slot.metrics.linesDropped += block->lines;
+        slot.metrics.bytesDropped += block->length;
+    }
+
+    void enqueue(Slot &slot, LineBlock *block) {
+        bool queued = slot.queue.push(block);
+
+        if (!queued) {
+            switch (slot.policy) {
+                case OverflowPolicy::DROP_NEWEST:
+                    break;
+                case OverflowPolicy::DROP_OLDEST: {
+                    LineBlock *evicted = slot.queue.replaceOldest(block);
+                    if (evicted != NULL) {
+                        TRACE_EVENT(TRACE_OVERFLOW, TRACE_OVF_SINK_QUEUE, evicted->length);
+                        countDrop(slot, evicted);
+                        evicted->release();
+                    }
+                    queued = true;
+                    break;
+                }
+                case OverflowPolicy::BLOCK: {
+                    uint32_t t1 = loggerMillis();
+                    uint32_t us1 = loggerMicros();
+                    while (!queued && loggerMillis() - t1 < slot.blockTimeoutMs) {
+                        loggerSleepMs(1);
+                        queued = slot.queue.push(block);
+                    }
+                    slot.metrics.blockedUs += loggerMicros() - us1;
+                    break;
+                }
+            }
+        }
+
+        if (queued) {
+            slot.metrics.blocksQueued++;
+            SinkCounters::raise(slot.metrics.maxDepth, slot.queue.size());
+        } else {
+            TRACE_EVENT(TRACE_OVERFLOW, TRACE_OVF_SINK_QUEUE, block->length);
+            countDrop(slot, block);
+            block->release();
+        }
+    }
+
+    Slot slots[MAX_SINKS];
+    int sinkCount;
+};
+
+// ---------------------------------------------------------------------------
+// Sink'и без залежностей від заліза - для хоста і для тестових прогонів
+// ---------------------------------------------------------------------------
+
+// Копіює дані в буфер фіксованого розміру, надлишок рахує як переповнення
+class MemorySink : public LogSink {
+public:
+    MemorySink(char *buffer, size_t capacity)
+        : buf(buffer), cap(capacity), used(0), overflowBytes(0) {}
+
+    const char *name() const override { return "memory"; }
+
+    bool write(const LineBlock &block) override {
+        size_t n = block.length;
+        if (n > cap - used) {
+            overflowBytes += n - (cap - used);
+            n = cap - used;
+        }
+        memcpy(buf + used, block.data, n);
+        used += n;
+        return true;
+    }
+
+    const char *data() const { return buf; }
+    size_t length() const { return used; }
+    size_t overflow() const { return overflowBytes; }
+    void clear() { used = 0; overflowBytes = 0; }
+
+private:
+    char *buf;
+    size_t cap;
+    size_t used;
+    size_t overflowBytes;
+};
+
+// Запис у файл через stdio (на хості - звичайний файл, на ESP32 - через VFS)
+class FileSink : public LogSink {
+public:
+    explicit FileSink(FILE *file, bool flushEachBatch = false)
+        : fp(file), flushBatch(flushEachBatch) {}
+
+    const char *name() const override { return "file"; }
+
+    bool write(const LineBlock &block) override {
+        if (fp == NULL) return false;
+        return fwrite(block.data, 1, block.length, fp) == block.length;
+    }
+
+    void flush() override {
+        if (fp != NULL && flushBatch) fflush(fp);
+    }
+
+private:
+    FILE *fp;
+    bool flushBatch;
+};
@@ -0,0 +1,58 @@
+/*
+ * Тонкий шар платформи для логіки конвеєра логера.
+ *
+ * Все, що не залежить від USB Host / SD / RTC, спирається тільки на ці
+ * функції - тому ті самі заголовки компілюються і на ESP32, і на хості
+ * (для прогону записаних логів через конвеєр на ПК).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+
+inline uint32_t loggerMicros() { return micros(); }
+inline uint32_t loggerMillis() { return millis(); }
+inline void loggerSleepMs(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms > 0 ? ms : 1)); }
+
+#define LOGGER_CORES portNUM_PROCESSORS
+inline int loggerCoreId() { return xPortGetCoreID(); }
+
+// Великі буфери кладемо в PSRAM якщо вона є - внутрішня RAM потрібна USB і SD
+inline void *loggerAlloc(size_t size) {
+#ifdef BOARD_HAS_PSRAM
+    void *ptr = ps_malloc(size);
+    if (ptr != NULL) return ptr;
+#endif
+    return malloc(size);
+}
+#else
+#include <chrono>
+#include <thread>
+
+inline uint32_t loggerMicros() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t loggerMillis() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline void loggerSleepMs(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms > 0 ? ms : 1));
+}
+inline void *loggerAlloc(size_t size) { return malloc(size); }
+
+// На хості всі потоки вважаємо одним "ядром"
+#define LOGGER_CORES 1
+inline int loggerCoreId() { return 0; }
+#endif
+
+inline void loggerFree(void *ptr) { free(ptr); }
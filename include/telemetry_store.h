@@ -0,0 +1,323 @@
+/*
+ * Витяг числової телеметрії з рядків у колонковий бінарний файл.
+ *
+ * Рядки, що відповідають налаштованій схемі (key=value або CSV), не
+ * пишуться в текстовий лог - їх числа додаються в колонки схеми:
+ * окрема колонка часу і по колонці на кожне поле. Кожна колонка
+ * кодується як zigzag-varint дельт від попереднього значення, тому
+ * повільно змінні сигнали займають 1-2 байти на відлік.
+ *
+ * Формат файлу (.tlm, little-endian):
+ *   "TLM1" u8 schemaCount
+ *     для кожної схеми: u8 id, u8 decimals, u8 fieldCount, u8 nameLen, name,
+ *                       для кожного поля: u8 nameLen, name
+ *   далі блоки:
+ *     "TB" u8 schemaId u8 columnCount u16 rowCount u32 columnBytes[columnCount]
+ *     колонки підряд; колонка 0 - час у мс, далі поля (value * 10^decimals)
+ *     перше значення колонки - абсолютне, решта - дельти.
+ * Довжини колонок у заголовку блоку дозволяють читачу пропускати
+ * непотрібні канали і чужі схеми без декодування.
+ */
+#pragma once
+
+#include <string.h>
+#include <atomic>
+#include "logger_port.h"
+
+#define TELEMETRY_MAX_SCHEMAS 4
+#define TELEMETRY_MAX_FIELDS 8
+#define TELEMETRY_MAX_ROWS 1024
+#define TELEMETRY_BLOCK_BYTES 3968   // Дані колонок одного блоку (блок + заголовок < 4KB)
+#define TELEMETRY_MAX_VARINT 10
+#define TELEMETRY_MAX_VALUE 999999999999999999LL   // |value * 10^decimals| - 18 цифр, дельти вміщаються в int64
+
+enum class TelemetryFormat : uint8_t {
+    KEY_VALUE,  // "temp=21.5 hum=40" (роздільники: пробіл, ',', ';', таб), лише ключі схеми
+    CSV         // "<prefix>21.5,40,..." - всі колонки по порядку
+};
+
+struct TelemetrySchema {
+    const char *name;
+    TelemetryFormat format;
+    const char *prefix;        // Рядок має починатися з цього префікса ("" - будь-який)
+    uint8_t decimals;          // Значення зберігаються як value * 10^decimals
+    uint8_t fieldCount;
+    const char *fields[TELEMETRY_MAX_FIELDS];  // Ключі (KEY_VALUE) або імена колонок (CSV)
+};
+
+struct TelemetryStats {
+    uint32_t linesMatched;
+    uint32_t linesUnmatched;
+    uint32_t blocksWritten;
+    uint32_t textBytes;        // Скільки байт зайняли б ці рядки в текстовому лозі
+    uint32_t encodedBytes;     // Скільки байт записано в колонковий файл
+    uint32_t encodeTimeUs;
+};
+
+// Куди віддавати готові блоки (файл на SD, файл на хості...)
+typedef void (*TelemetryWriteFn)(const uint8_t *data, size_t len, void *ctx);
+
+class TelemetryStore {
+public:
+    TelemetryStore() : schemaCount(0), writeFn(NULL), writeCtx(NULL), enabled(false), flushRequested(false) {
+        memset(&st, 0, sizeof(st));
+    }
+
+    void setOutput(TelemetryWriteFn fn, void *ctx) {
+        writeFn = fn;
+        writeCtx = ctx;
+    }
+
+    bool addSchema(const TelemetrySchema &schema) {
+        if (schemaCount >= TELEMETRY_MAX_SCHEMAS) return false;
+        if (schema.fieldCount == 0 || schema.fieldCount > TELEMETRY_MAX_FIELDS) return false;
+        Column &c = cols[schemaCount];
+        c.schema = &schemas[schemaCount];
+        schemas[schemaCount] = schema;
+        c.columnCount = schema.fieldCount + 1;
+        c.columnCap = TELEMETRY_BLOCK_BYTES / c.columnCount;
+        resetColumns(c);
+        schemaCount++;
+        return true;
+    }
+
+    // Вмикання і запит скидання - безпечно з іншого потоку
+    void setEnabled(bool on) { enabled.store(on); }
+    bool isEnabled() const { return enabled.load() && schemaCount > 0; }
+
+    // Неповні блоки скине потік append()/flush() (IngestPipeline::poll)
+    void requestFlush() { flushRequested.store(true); }
+    bool takeFlushRequest() { return flushRequested.load(std::memory_order_relaxed) && flushRequested.exchange(false); }
+    int count() const { return schemaCount; }
+    const TelemetryStats &stats() const { return st; }
+    void resetStats() { memset(&st, 0, sizeof(st)); }
+
+    // Заголовок файлу з описом схем - пишеться на початку кожного .tlm
+    size_t writeHeader(uint8_t *buf, size_t cap) const {
+        size_t n = 0;
+        if (cap < 5) return 0;
+        memcpy(buf, "TLM1", 4);
+        n = 4;
+        buf[n++] = (uint8_t)schemaCount;
+        for (int i = 0; i < schemaCount; i++) {
+            const TelemetrySchema &s = schemas[i];
+            size_t nameLen = strlen(s.name);
+            if (n + 4 + nameLen > cap) return 0;
+            buf[n++] = (uint8_t)i;
+            buf[n++] = s.decimals;
+            buf[n++] = s.fieldCount;
+            buf[n++] = (uint8_t)nameLen;
+            memcpy(buf + n, s.name, nameLen);
+            n += nameLen;
+            for (int f = 0; f < s.fieldCount; f++) {
+                size_t fl = strlen(s.fields[f]);
+                if (n + 1 + fl > cap) return 0;
+                buf[n++] = (uint8_t)fl;
+                memcpy(buf + n, s.fields[f], fl);
+                n += fl;
+            }
+        }
+        return n;
+    }
+
+    // Пробує розпізнати рядок. true - рядок збережено в колонках
+    bool append(const char *line, size_t len, uint64_t timeMs) {
+        if (!isEnabled()) return false;
+        uint32_t t1 = loggerMicros();
+
+        int64_t values[TELEMETRY_MAX_FIELDS];
+        for (int i = 0; i < schemaCount; i++) {
+            const TelemetrySchema &s = schemas[i];
+            if (!parse(s, line, len, values)) continue;
+
+            Column &c = cols[i];
+            if (c.rows >= TELEMETRY_MAX_ROWS || c.minFree < TELEMETRY_MAX_VARINT) {
+                flushSchema(i);
+            }
+            putValue(c, 0, (int64_t)timeMs);
+            for (int f = 0; f < s.fieldCount; f++) {
+                putValue(c, f + 1, values[f]);
+            }
+            c.rows++;
+
+            st.linesMatched++;
+            st.textBytes += len + 1;
+            st.encodeTimeUs += loggerMicros() - t1;
+            return true;
+        }
+        st.linesUnmatched++;
+        return false;
+    }
+
+    // Скидає всі неповні блоки (перед зміною файлу, за таймером тощо).
+    // Тільки з потоку append(); з інших - requestFlush()
+    void flush() {
+        for (int i = 0; i < schemaCount; i++) flushSchema(i);
+    }
+
+    // Розбір числа з фіксованою комою без strtod: "-12.345" при decimals=2 -> -1234.
+    // Більше за TELEMETRY_MAX_VALUE - не число телеметрії, рядок лишається текстом
+    static bool parseFixed(const char *s, const char *end, uint8_t decimals, int64_t *out) {
+        while (s < end && *s == ' ') s++;
+        while (end > s && (end[-1] == ' ' || end[-1] == '\r')) end--;
+        if (s >= end) return false;
+
+        bool negative = false;
+        if (*s == '-' || *s == '+') {
+            negative = (*s == '-');
+            s++;
+        }
+        int64_t value = 0;
+        int digits = 0;
+        int fraction = -1;
+        for (; s < end; s++) {
+            char ch = *s;
+            if (ch >= '0' && ch <= '9') {
+                if (fraction >= 0) {
+                    if (fraction >= decimals) continue;  // Зайві знаки відкидаємо
+                    fraction++;
+                }
+                if (value > (TELEMETRY_MAX_VALUE - (ch - '0')) / 10) return false;
+                value = value * 10 + (ch - '0');
+                digits++;
+            } else if (ch == '.' && fraction < 0) {
+                fraction = 0;
+            } else {
+                return false;
+            }
+        }
+        if (digits == 0) return false;
+        for (int f = fraction < 0 ? 0 : fraction; f < decimals; f++) {
+            if (value > TELEMETRY_MAX_VALUE / 10) return false;
+            value *= 10;
+        }
+        *out = negative ? -value : value;
+        return true;
+    }
+
+private:
+    struct Column {
+        const TelemetrySchema *schema;
+        uint8_t columnCount;
+        uint16_t columnCap;
+        uint16_t rows;
+        uint16_t minFree;                          // Найменше вільне місце серед колонок
+        uint16_t used[TELEMETRY_MAX_FIELDS + 1];
+        int64_t last[TELEMETRY_MAX_FIELDS + 1];
+        uint8_t data[TELEMETRY_BLOCK_BYTES];       // Розбито на columnCount рівних частин
+    };
+
+    static bool isSeparator(char ch) {
+        return ch == ' ' || ch == ',' || ch == ';' || ch == '\t' || ch == '\r';
+    }
+
+    bool parse(const TelemetrySchema &s, const char *line, size_t len, int64_t *values) const {
+        size_t prefixLen = strlen(s.prefix);
+        if (len < prefixLen || memcmp(line, s.prefix, prefixLen) != 0) return false;
+        const char *p = line + prefixLen;
+        const char *end = line + len;
+
+        if (s.format == TelemetryFormat::CSV) {
+            for (int f = 0; f < s.fieldCount; f++) {
+                const char *comma = p;
+                while (comma < end && *comma != ',') comma++;
+                if (!parseFixed(p, comma, s.decimals, &values[f])) return false;
+                if (f + 1 < s.fieldCount) {
+                    if (comma >= end) return false;
+                    p = comma + 1;
+                } else if (comma != end) {
+                    return false;  // Зайві колонки - це вже інша схема
+                }
+            }
+            return true;
+        }
+
+        // KEY_VALUE: всі ключі схеми присутні, і нічого крім них. Рядок з іншими словами
+        // ("Error: temp=85 hum=40 overheat") - повідомлення, його текст має лишитись у лозі
+        uint32_t found = 0;
+        while (p < end) {
+            while (p < end && isSeparator(*p)) p++;
+            if (p >= end) break;
+            const char *tokenStart = p;
+            while (p < end && !isSeparator(*p)) p++;
+            const char *eq = (const char *)memchr(tokenStart, '=', p - tokenStart);
+            if (eq == NULL) return false;
+            size_t keyLen = eq - tokenStart;
+            int field = -1;
+            for (int f = 0; f < s.fieldCount; f++) {
+                if (strlen(s.fields[f]) == keyLen && memcmp(s.fields[f], tokenStart, keyLen) == 0) {
+                    field = f;
+                    break;
+                }
+            }
+            if (field < 0 || (found & (1u << field))) return false;
+            if (!parseFixed(eq + 1, p, s.decimals, &values[field])) return false;
+            found |= (1u << field);
+        }
+        return found == (1u << s.fieldCount) - 1;
+    }
+
+    void resetColumns(Column &c) {
+        c.rows = 0;
+        c.minFree = c.columnCap;
+        memset(c.used, 0, sizeof(c.used));
+        memset(c.last, 0, sizeof(c.last));
+    }
+
+    void putValue(Column &c, int col, int64_t value) {
+        int64_t delta = c.rows == 0 ? value : value - c.last[col];
+        c.last[col] = value;
+        uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+        uint8_t *dst = c.data + col * c.columnCap + c.used[col];
+        uint16_t n = 0;
+        while (zz >= 0x80) {
+            dst[n++] = (uint8_t)(zz | 0x80);
+            zz >>= 7;
+        }
+        dst[n++] = (uint8_t)zz;
+        c.used[col] += n;
+
+        uint16_t freeBytes = c.columnCap - c.used[col];
+        if (freeBytes < c.minFree) c.minFree = freeBytes;
+    }
+
+    void flushSchema(int index) {
+        Column &c = cols[index];
+        if (c.rows == 0) return;
+
+        size_t n = 0;
+        out[n++] = 'T';
+        out[n++] = 'B';
+        out[n++] = (uint8_t)index;
+        out[n++] = c.columnCount;
+        out[n++] = (uint8_t)(c.rows & 0xFF);
+        out[n++] = (uint8_t)(c.rows >> 8);
+        for (int col = 0; col < c.columnCount; col++) {
+            uint32_t len = c.used[col];
+            out[n++] = (uint8_t)len;
+            out[n++] = (uint8_t)(len >> 8);
+            out[n++] = (uint8_t)(len >> 16);
+            out[n++] = (uint8_t)(len >> 24);
+        }
+        for (int col = 0; col < c.columnCount; col++) {
+            memcpy(out + n, c.data + col * c.columnCap, c.used[col]);
+            n += c.used[col];
+        }
+
+        if (writeFn != NULL) writeFn(out, n, writeCtx);
+        st.blocksWritten++;
+        st.encodedBytes += n;
+        resetColumns(c);
+    }
+
+    TelemetrySchema schemas[TELEMETRY_MAX_SCHEMAS];
+    Column cols[TELEMETRY_MAX_SCHEMAS];
+    int schemaCount;
+    uint8_t out[6 + 4 * (TELEMETRY_MAX_FIELDS + 1) + TELEMETRY_BLOCK_BYTES];
+    TelemetryWriteFn writeFn;
+    void *writeCtx;
+    std::atomic<bool> enabled;
+    std::atomic<bool> flushRequested;
+    TelemetryStats st;
+};
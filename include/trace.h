@@ -0,0 +1,189 @@
+/*
+ * Трасування подій конвеєра для перегляду в Chrome/Perfetto (trace_export.py).
+ *
+ * Подія - 8 байт у кільці СВОГО ядра: час (мкс), тип, допоміжний байт і
+ * 16-бітний аргумент. Запис без блокувань: слот резервується одним атомарним
+ * fetch_add, тому задача чи переривання, що витіснили запис на тому ж ядрі,
+ * беруть наступний слот. Кільце перезаписується по колу - зберігаються
+ * останні TRACE_RING_EVENTS подій кожного ядра.
+ *
+ * Час - loggerMicros() (esp_timer): лічильник тактів CCOUNT окремий на кожному
+ * ядрі і не синхронізований, а події двох ядер мають лягти на одну шкалу.
+ * Задачі не прив'язані до ядер: begin і end одного span'у можуть бути в
+ * різних кільцях, тому trace_export.py зводить їх і шукає пари по задачі.
+ *
+ * Без -DLOGGER_TRACE макрос TRACE_EVENT порожній, кілець немає - ні коду, ні пам'яті.
+ */
+#pragma once
+
+#include <string.h>
+#include <atomic>
+#include "logger_port.h"
+
+#ifndef TRACE_RING_EVENTS
+#define TRACE_RING_EVENTS 2048      // Подій на ядро, степінь двійки (8 байт кожна)
+#endif
+
+#define TRACE_MAGIC "TRC1"
+#define TRACE_HEADER_BYTES 16
+#define TRACE_CORE_HEADER_BYTES 8
+
+enum TraceEventType : uint8_t {
+    TRACE_NONE = 0,
+    TRACE_USB_TRANSFER,      // aux - адреса endpoint'а, arg - байт у transfer'і
+    TRACE_USB_RESUBMIT,      // aux - адреса endpoint'а, arg - 1 якщо перезапуск не вдався
+    TRACE_BATCH_BEGIN,       // arg - ліміт пачки, рядків
+    TRACE_BATCH_END,         // arg - оброблено рядків
+    TRACE_SD_WRITE_BEGIN,    // aux - файл (TraceSdFile), arg - байт
+    TRACE_SD_WRITE_END,      // aux - файл, arg - 1 якщо запис вдався
+    TRACE_SD_FLUSH_BEGIN,    // aux - файл
+    TRACE_SD_FLUSH_END,      // aux - файл
+    TRACE_OVERFLOW,          // aux - де (TraceOverflowSource), arg - байт/рядків втрачено
+};
+
+enum TraceOverflowSource : uint8_t {
+    TRACE_OVF_USB_RING,      // USB дані не влізли в кільце потоку (байт)
+    TRACE_OVF_SINK_QUEUE,    // Блок відкинуто чергою sink'а (байт)
+    TRACE_OVF_BLOCK_POOL,    // Немає вільного блоку (рядків)
+};
+
+enum TraceSdFile : uint8_t {
+    TRACE_SD_LOG,
+    TRACE_SD_TELEMETRY,
+};
+
+struct TraceRecord {
+    uint32_t timeUs;
+    uint8_t type;
+    uint8_t aux;
+    uint16_t arg;
+};
+
+static_assert(sizeof(TraceRecord) == 8, "TraceRecord must stay 8 bytes");
+static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0, "TRACE_RING_EVENTS must be a power of two");
+
+// Кільце одного ядра
+class TraceRing {
+public:
+    TraceRing() : head(0) { memset(slots, 0, sizeof(slots)); }
+
+    void record(uint8_t type, uint8_t aux, uint32_t arg) {
+        uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+        TraceRecord &r = slots[index & (TRACE_RING_EVENTS - 1)];
+        r.timeUs = loggerMicros();
+        r.aux = aux;
+        r.arg = arg > 0xFFFF ? 0xFFFF : (uint16_t)arg;
+        r.type = type;
+    }
+
+    uint32_t written() const { return head.load(std::memory_order_relaxed); }
+    uint32_t stored() const { uint32_t n = written(); return n < TRACE_RING_EVENTS ? n : TRACE_RING_EVENTS; }
+    const TraceRecord &at(uint32_t index) const { return slots[index & (TRACE_RING_EVENTS - 1)]; }
+
+    void clear() {
+        memset(slots, 0, sizeof(slots));
+        head.store(0);
+    }
+
+private:
+    TraceRecord slots[TRACE_RING_EVENTS];
+    std::atomic<uint32_t> head;
+};
+
+// Кільця всіх ядер і вивантаження в компактний бінарний вигляд:
+//   "TRC1" u8 ядер, u8 розмір події, u16 0, u32 час вивантаження, u32 0
+//   на кожне ядро: u32 перезаписано подій, u32 подій, події від найстарішої
+//   u32 FNV-1a усіх попередніх байт
+// Всі числа little-endian (як у пам'яті ESP32 і x86)
+class Tracer {
+public:
+    Tracer() : enabled(true) {}
+
+    void record(uint8_t type, uint8_t aux = 0, uint32_t arg = 0) {
+        if (!enabled.load(std::memory_order_relaxed)) return;
+        rings[loggerCoreId() % LOGGER_CORES].record(type, aux, arg);
+    }
+
+    void setEnabled(bool on) { enabled.store(on); }
+    bool isEnabled() const { return enabled.load(); }
+
+    uint32_t written() const {
+        uint32_t total = 0;
+        for (int i = 0; i < LOGGER_CORES; i++) total += rings[i].written();
+        return total;
+    }
+
+    // Вивантажувати тільки з вимкненим записом - інакше найстаріші події можуть перезаписатись
+    void clear() {
+        for (int i = 0; i < LOGGER_CORES; i++) rings[i].clear();
+    }
+
+    static size_t maxSerializedSize() {
+        return TRACE_HEADER_BYTES + LOGGER_CORES * (TRACE_CORE_HEADER_BYTES + TRACE_RING_EVENTS * sizeof(TraceRecord)) + 4;
+    }
+
+    // Повертає довжину або 0 якщо буфер замалий. Виклик - при вимкненому записі
+    size_t serialize(uint8_t *buf, size_t cap) const {
+        if (cap < maxSerializedSize()) return 0;
+        size_t n = 0;
+        memcpy(buf, TRACE_MAGIC, 4);
+        n += 4;
+        buf[n++] = LOGGER_CORES;
+        buf[n++] = sizeof(TraceRecord);
+        n = put16(buf, n, 0);
+        n = put32(buf, n, loggerMicros());
+        n = put32(buf, n, 0);
+
+        for (int core = 0; core < LOGGER_CORES; core++) {
+            const TraceRing &ring = rings[core];
+            uint32_t total = ring.written();
+            uint32_t count = ring.stored();
+            n = put32(buf, n, total - count);
+            size_t countPos = n;
+            n += 4;
+            uint32_t emitted = 0;
+            for (uint32_t i = total - count; i != total; i++) {
+                const TraceRecord &r = ring.at(i);
+                if (r.type == TRACE_NONE) continue;  // Слот зарезервовано, але не дописано
+                n = put32(buf, n, r.timeUs);
+                buf[n++] = r.type;
+                buf[n++] = r.aux;
+                n = put16(buf, n, r.arg);
+                emitted++;
+            }
+            put32(buf, countPos, emitted);
+        }
+        return put32(buf, n, fnv1a(buf, n));
+    }
+
+    static uint32_t fnv1a(const uint8_t *data, size_t len) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < len; i++) {
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+private:
+    static size_t put16(uint8_t *buf, size_t n, uint16_t v) {
+        buf[n] = v & 0xFF;
+        buf[n + 1] = v >> 8;
+        return n + 2;
+    }
+
+    static size_t put32(uint8_t *buf, size_t n, uint32_t v) {
+        for (int i = 0; i < 4; i++) buf[n + i] = (v >> (8 * i)) & 0xFF;
+        return n + 4;
+    }
+
+    TraceRing rings[LOGGER_CORES];
+    std::atomic<bool> enabled;
+};
+
+#ifdef LOGGER_TRACE
+extern Tracer tracer;             // Визначається один раз у main.cpp
+#define TRACE_EVENT(type, aux, arg) tracer.record((type), (aux), (arg))
+#else
+#define TRACE_EVENT(type, aux, arg) ((void)0)
+#endif
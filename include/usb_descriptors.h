@@ -0,0 +1,294 @@
+/*
+ * Розбір дескриптора конфігурації USB і сповіщень CDC.
+ *
+ * Працює з сирими байтами (без типів ESP-IDF), тому той самий код
+ * перевіряється на хості на збережених дескрипторах пристроїв.
+ *
+ * Складені пристрої: розбираються ВСІ інтерфейси (alt 0), асоціації
+ * (IAD) і CDC Union, тому кожен bulk IN стає окремим потоком, а
+ * interrupt IN інтерфейсу керування CDC - джерелом сповіщень
+ * (SERIAL_STATE: DCD/DSR/break/ring/помилки лінії).
+ */
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#define USBDESC_MAX_INTERFACES 16
+#define USBDESC_MAX_ENDPOINTS 16
+#define USBDESC_MAX_FUNCTIONS 8
+
+// Типи дескрипторів і класи, які нас цікавлять
+#define USBDESC_TYPE_CONFIGURATION 0x02
+#define USBDESC_TYPE_INTERFACE 0x04
+#define USBDESC_TYPE_ENDPOINT 0x05
+#define USBDESC_TYPE_IAD 0x0B
+#define USBDESC_TYPE_CS_INTERFACE 0x24
+#define USBDESC_CDC_SUBTYPE_UNION 0x06
+#define USBDESC_CLASS_CDC 0x02
+#define USBDESC_CLASS_CDC_DATA 0x0A
+#define USBDESC_CLASS_VENDOR 0xFF
+#define USBDESC_EP_BULK 0x02
+#define USBDESC_EP_INTERRUPT 0x03
+
+struct UsbInterfaceInfo {
+    uint8_t number;
+    uint8_t cls;
+    uint8_t subClass;
+    uint8_t protocol;
+    uint8_t numEndpoints;
+    int8_t function;           // Індекс асоціації (IAD) або -1
+    int8_t controlInterface;   // Для CDC Data - інтерфейс керування (Union), або -1
+};
+
+struct UsbEndpointInfo {
+    uint8_t address;
+    uint8_t type;              // USBDESC_EP_BULK, USBDESC_EP_INTERRUPT, ...
+    uint16_t maxPacket;
+    uint8_t interval;
+    uint8_t interfaceIndex;    // Індекс у UsbConfigLayout::interfaces
+};
+
+// Які bulk IN брати потоками
+enum UsbStreamClass : uint8_t {
+    USB_STREAM_CDC_DATA = 0x01,
+    USB_STREAM_VENDOR = 0x02,
+    USB_STREAM_OTHER = 0x04,
+    USB_STREAM_ANY = 0x07
+};
+
+struct UsbStreamSelection {
+    uint8_t classes;           // Маска UsbStreamClass
+    uint32_t interfaceMask;    // Біт на номер інтерфейсу, 0 - будь-який
+};
+
+class UsbConfigLayout {
+public:
+    UsbConfigLayout() { clear(); }
+
+    void clear() {
+        interfaceCount = endpointCount = functionCount = unionCount = 0;
+        truncated = false;
+    }
+
+    // Розбирає дескриптор конфігурації. false - дескриптор пошкоджений
+    bool parse(const uint8_t *data, size_t len) {
+        clear();
+        if (len < 4 || data[1] != USBDESC_TYPE_CONFIGURATION) return false;
+        size_t total = data[2] | (data[3] << 8);
+        if (total < len) len = total;
+
+        int current = -1;        // Поточний інтерфейс (alt 0) або -1 для alt != 0
+        size_t offset = 0;
+        while (offset + 2 <= len) {
+            uint8_t dlen = data[offset];
+            uint8_t type = data[offset + 1];
+            if (dlen < 2 || offset + dlen > len) return false;
+            const uint8_t *d = data + offset;
+
+            if (type == USBDESC_TYPE_IAD && dlen >= 8) {
+                if (functionCount < USBDESC_MAX_FUNCTIONS) {
+                    functionFirst[functionCount] = d[2];
+                    functionSize[functionCount] = d[3];
+                    functionClass[functionCount] = d[4];
+                    functionCount++;
+                } else {
+                    truncated = true;
+                }
+            } else if (type == USBDESC_TYPE_INTERFACE && dlen >= 9) {
+                current = -1;
+                // Альтернативні налаштування не чіпаємо - claim іде з alt 0
+                if (d[3] == 0) {
+                    if (interfaceCount < USBDESC_MAX_INTERFACES) {
+                        UsbInterfaceInfo &intf = interfaces[interfaceCount];
+                        intf.number = d[2];
+                        intf.numEndpoints = d[4];
+                        intf.cls = d[5];
+                        intf.subClass = d[6];
+                        intf.protocol = d[7];
+                        intf.function = functionOf(d[2]);
+                        intf.controlInterface = -1;
+                        current = interfaceCount++;
+                    } else {
+                        truncated = true;
+                    }
+                }
+            } else if (type == USBDESC_TYPE_CS_INTERFACE && dlen >= 5 && current >= 0 &&
+                       d[2] == USBDESC_CDC_SUBTYPE_UNION) {
+                // Union: перший - інтерфейс керування, далі - підлеглі (Data)
+                for (uint8_t i = 4; i < dlen; i++) {
+                    unionPending(d[3], d[i]);
+                }
+            } else if (type == USBDESC_TYPE_ENDPOINT && dlen >= 7 && current >= 0) {
+                if (endpointCount < USBDESC_MAX_ENDPOINTS) {
+                    UsbEndpointInfo &ep = endpoints[endpointCount++];
+                    ep.address = d[2];
+                    ep.type = d[3] & 0x03;
+                    ep.maxPacket = (d[4] | (d[5] << 8)) & 0x07FF;
+                    ep.interval = d[6];
+                    ep.interfaceIndex = (uint8_t)current;
+                } else {
+                    truncated = true;
+                }
+            }
+            offset += dlen;
+        }
+        resolveUnions();
+        return true;
+    }
+
+    int interfacesCount() const { return interfaceCount; }
+    int endpointsCount() const { return endpointCount; }
+    int functionsCount() const { return functionCount; }
+    uint8_t functionClassAt(int i) const { return functionClass[i]; }
+    bool isTruncated() const { return truncated; }
+    const UsbInterfaceInfo &interfaceAt(int i) const { return interfaces[i]; }
+    const UsbEndpointInfo &endpointAt(int i) const { return endpoints[i]; }
+    const UsbInterfaceInfo &interfaceOf(const UsbEndpointInfo &ep) const { return interfaces[ep.interfaceIndex]; }
+
+    static bool isIn(const UsbEndpointInfo &ep) { return (ep.address & 0x80) != 0; }
+
+    bool isBulkIn(const UsbEndpointInfo &ep) const { return isIn(ep) && ep.type == USBDESC_EP_BULK; }
+
+    // Interrupt IN інтерфейсу керування CDC - сповіщення SERIAL_STATE
+    bool isNotification(const UsbEndpointInfo &ep) const {
+        return isIn(ep) && ep.type == USBDESC_EP_INTERRUPT && interfaceOf(ep).cls == USBDESC_CLASS_CDC;
+    }
+
+    bool matches(const UsbEndpointInfo &ep, const UsbStreamSelection &sel) const {
+        if (!isBulkIn(ep)) return false;
+        const UsbInterfaceInfo &intf = interfaceOf(ep);
+        if (sel.interfaceMask != 0 && (intf.number >= 32 || !(sel.interfaceMask & (1UL << intf.number)))) {
+            return false;
+        }
+        uint8_t cls = intf.cls == USBDESC_CLASS_CDC_DATA ? USB_STREAM_CDC_DATA
+                    : intf.cls == USBDESC_CLASS_VENDOR ? USB_STREAM_VENDOR
+                    : USB_STREAM_OTHER;
+        return (sel.classes & cls) != 0;
+    }
+
+    // Номер інтерфейсу керування для потоку (Union, IAD або сусідній), -1 якщо немає
+    int controlInterfaceFor(const UsbEndpointInfo &ep) const {
+        const UsbInterfaceInfo &intf = interfaceOf(ep);
+        if (intf.controlInterface >= 0) return intf.controlInterface;
+        if (intf.cls != USBDESC_CLASS_CDC_DATA) return -1;
+        for (int i = 0; i < interfaceCount; i++) {
+            const UsbInterfaceInfo &c = interfaces[i];
+            if (c.cls != USBDESC_CLASS_CDC) continue;
+            if (intf.function >= 0 && c.function == intf.function) return c.number;
+            if (intf.function < 0 && c.function < 0 && c.number + 1 == intf.number) return c.number;
+        }
+        return -1;
+    }
+
+private:
+    int8_t functionOf(uint8_t number) const {
+        for (int i = 0; i < functionCount; i++) {
+            if (number >= functionFirst[i] && number < functionFirst[i] + functionSize[i]) return (int8_t)i;
+        }
+        return -1;
+    }
+
+    // Union може посилатись на інтерфейс, який ще не розібрано - запам'ятовуємо пари
+    void unionPending(uint8_t control, uint8_t sub) {
+        if (unionCount < USBDESC_MAX_INTERFACES) {
+            unionControl[unionCount] = control;
+            unionSub[unionCount] = sub;
+            unionCount++;
+        }
+    }
+
+    void resolveUnions() {
+        for (int u = 0; u < unionCount; u++) {
+            for (int i = 0; i < interfaceCount; i++) {
+                if (interfaces[i].number == unionSub[u]) interfaces[i].controlInterface = unionControl[u];
+            }
+        }
+        unionCount = 0;
+    }
+
+    UsbInterfaceInfo interfaces[USBDESC_MAX_INTERFACES];
+    UsbEndpointInfo endpoints[USBDESC_MAX_ENDPOINTS];
+    uint8_t functionFirst[USBDESC_MAX_FUNCTIONS];
+    uint8_t functionSize[USBDESC_MAX_FUNCTIONS];
+    uint8_t functionClass[USBDESC_MAX_FUNCTIONS];
+    uint8_t unionControl[USBDESC_MAX_INTERFACES];
+    uint8_t unionSub[USBDESC_MAX_INTERFACES];
+    int interfaceCount;
+    int endpointCount;
+    int functionCount;
+    int unionCount;
+    bool truncated;
+};
+
+// ---------------------------------------------------------------------------
+// Сповіщення CDC (PSTN): 8 байт заголовка + дані
+// ---------------------------------------------------------------------------
+
+#define CDC_NOTIFY_NETWORK_CONNECTION 0x00
+#define CDC_NOTIFY_RESPONSE_AVAILABLE 0x01
+#define CDC_NOTIFY_SERIAL_STATE 0x20
+
+// Біти SERIAL_STATE: DCD/DSR - стан, решта - одноразові події
+#define CDC_SERIAL_DCD 0x01
+#define CDC_SERIAL_DSR 0x02
+#define CDC_SERIAL_BREAK 0x04
+#define CDC_SERIAL_RING 0x08
+#define CDC_SERIAL_FRAMING 0x10
+#define CDC_SERIAL_PARITY 0x20
+#define CDC_SERIAL_OVERRUN 0x40
+
+struct CdcNotification {
+    uint8_t code;
+    uint16_t value;
+    uint16_t interfaceNumber;
+    uint16_t state;            // Дані SERIAL_STATE
+    bool hasState;
+};
+
+inline bool parseCdcNotification(const uint8_t *data, size_t len, CdcNotification &out) {
+    if (len < 8 || data[0] != 0xA1) return false;
+    out.code = data[1];
+    out.value = data[2] | (data[3] << 8);
+    out.interfaceNumber = data[4] | (data[5] << 8);
+    uint16_t dataLen = data[6] | (data[7] << 8);
+    out.hasState = out.code == CDC_NOTIFY_SERIAL_STATE && dataLen >= 2 && len >= 10;
+    out.state = out.hasState ? (uint16_t)(data[8] | (data[9] << 8)) : 0;
+    return true;
+}
+
+// Текст для логу: "CDC if0 SERIAL_STATE DCD=1 DSR=0 BREAK". Повертає довжину
+inline size_t formatCdcNotification(const CdcNotification &n, char *buf, size_t cap) {
+    int w;
+    switch (n.code) {
+        case CDC_NOTIFY_SERIAL_STATE:
+            if (!n.hasState) {
+                w = snprintf(buf, cap, "CDC if%u SERIAL_STATE (без даних)", n.interfaceNumber);
+                break;
+            }
+            w = snprintf(buf, cap, "CDC if%u SERIAL_STATE DCD=%d DSR=%d%s%s%s%s%s",
+                         n.interfaceNumber,
+                         (n.state & CDC_SERIAL_DCD) ? 1 : 0,
+                         (n.state & CDC_SERIAL_DSR) ? 1 : 0,
+                         (n.state & CDC_SERIAL_BREAK) ? " BREAK" : "",
+                         (n.state & CDC_SERIAL_RING) ? " RING" : "",
+                         (n.state & CDC_SERIAL_FRAMING) ? " FRAMING-ERROR" : "",
+                         (n.state & CDC_SERIAL_PARITY) ? " PARITY-ERROR" : "",
+                         (n.state & CDC_SERIAL_OVERRUN) ? " OVERRUN" : "");
+            break;
+        case CDC_NOTIFY_NETWORK_CONNECTION:
+            w = snprintf(buf, cap, "CDC if%u NETWORK_CONNECTION %s",
+                         n.interfaceNumber, n.value ? "connected" : "disconnected");
+            break;
+        case CDC_NOTIFY_RESPONSE_AVAILABLE:
+            w = snprintf(buf, cap, "CDC if%u RESPONSE_AVAILABLE", n.interfaceNumber);
+            break;
+        default:
+            w = snprintf(buf, cap, "CDC if%u notification 0x%02X value=0x%04X",
+                         n.interfaceNumber, n.code, n.value);
+            break;
+    }
+    if (w < 0) return 0;
+    return (size_t)w < cap ? (size_t)w : cap - 1;
+}
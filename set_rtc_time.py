@@ -1,31 +1,68 @@
 #!/usr/bin/env python3
 """
-RTC Time Setter - Встановлює системний час на RTC годинник ESP32
+RTC Time Setter - синхронізує годинник логера ESP32 з системним часом
+
+NTP-подібний обмін через Serial замість "settime" з точністю до секунди:
+  1. N проб "sync <t1>": логер відповідає моментом приходу команди (t2)
+     і відповіді (t3) за своїм мікросекундним таймером. Зсув і RTT
+     рахуються як у NTP, береться проба з мінімальним RTT - вона найменше
+     спотворена чергами USB-UART моста і опитуванням команд.
+  2. "settime ... @US": логер записує RTC рівно на межі секунди
+     (фаза RTC збігається з системним годинником).
+  3. Повторні проби з настінним часом логера - досягнутий зсув.
+
+Режим --loopback проганяє той самий алгоритм проти симульованого логера
+з затримкою лінії, джитером і асиметрією - без заліза.
+
+Використання:
+    python set_rtc_time.py                    # знайти порт, синхронізувати
+    python set_rtc_time.py --port COM5 --check
+    python set_rtc_time.py --loopback --delay-ms 4 --jitter-ms 2
 """
 
-import serial
-import serial.tools.list_ports
+import argparse
 import datetime
-import time
+import random
+import statistics
 import sys
+import time
+
+EPOCH = datetime.datetime(1970, 1, 1)
+
+
+class HostClock:
+    """Місцевий час хоста в мкс (RTC логера зберігає місцевий час).
+    Один відлік системного часу + монотонний perf_counter - без стрибків
+    і з кращою роздільністю, ніж time.time() на Windows."""
+
+    def __init__(self):
+        utc_offset = datetime.datetime.now().astimezone().utcoffset()
+        self.wall_anchor_us = time.time_ns() // 1000 + int(utc_offset.total_seconds() * 1e6)
+        self.perf_anchor_ns = time.perf_counter_ns()
+
+    def now_us(self):
+        return self.wall_anchor_us + (time.perf_counter_ns() - self.perf_anchor_ns) // 1000
+
 
 def find_esp32_port():
     """Знаходить COM порт ESP32"""
+    import serial.tools.list_ports
+
     ports = serial.tools.list_ports.comports()
-    
+
     # Шукаємо ESP32 за описом
     esp32_keywords = ['ESP32', 'Silicon Labs', 'CH340', 'CP210', 'USB Serial']
-    
+
     for port in ports:
         for keyword in esp32_keywords:
             if keyword.lower() in port.description.lower():
                 return port.device
-    
+
     # Якщо не знайшли автоматично, показуємо всі доступні порти
     print("ESP32 не знайдено автоматично. Доступні порти:")
     for i, port in enumerate(ports):
         print(f"{i+1}. {port.device} - {port.description}")
-    
+
     if ports:
         try:
             choice = int(input("Виберіть номер порту: ")) - 1
@@ -33,101 +70,347 @@ def find_esp32_port():
                 return ports[choice].device
         except ValueError:
             pass
-    
+
     return None
 
-def set_rtc_time():
-    """Встановлює поточний системний час на RTC"""
+
+class SerialLink:
+    """Рядки через справжній послідовний порт"""
+
+    def __init__(self, port, baud, clock):
+        import serial
+
+        self.clock = clock
+        self.ser = serial.Serial(port, baud, timeout=0.05)
+        time.sleep(2)  # Відкриття порту може перезавантажити ESP32
+        self.ser.reset_input_buffer()
+        self.buffer = b""
+        self.rx_us = 0
+
+    def write_line(self, text):
+        self.ser.write(text.encode('utf-8'))
+        self.ser.flush()
+
+    def read_line(self, timeout):
+        """Повертає (рядок, мкс хоста на момент приходу) або (None, None)"""
+        deadline = time.monotonic() + timeout
+        while True:
+            nl = self.buffer.find(b"\n")
+            if nl >= 0:
+                line, self.buffer = self.buffer[:nl], self.buffer[nl + 1:]
+                return line.decode('utf-8', 'replace').strip(), self.rx_us
+            if time.monotonic() >= deadline:
+                return None, None
+            chunk = self.ser.read(max(1, self.ser.in_waiting))
+            if chunk:
+                # Час приходу - момент, коли отримано байти з кінцем рядка
+                self.rx_us = self.clock.now_us()
+                self.buffer += chunk
+
+    def close(self):
+        self.ser.close()
+
+
+class SimulatedLogger:
+    """Логер за симульованою лінією для --loopback.
+
+    Власний мкс-таймер (довільний зсув + дрейф кварцу), опитування команд
+    з періодом poll_ms, серіалізація рядків на baud, затримка USB-моста
+    з джитером і асиметрією. Відповідає на sync/settime як прошивка."""
+
+    def __init__(self, clock, args):
+        self.clock = clock
+        self.baud = args.baud
+        self.delay_us = args.delay_ms * 1000
+        self.jitter_us = args.jitter_ms * 1000
+        self.asymmetry_us = args.asymmetry_ms * 1000
+        self.poll_us = args.poll_ms * 1000
+        self.drift = args.drift_ppm * 1e-6
+        self.timer_offset_us = random.randint(10_000_000, 4_000_000_000)
+        # Годинник логера до синхронізації - зсунутий на clock_offset_s
+        start = clock.now_us()
+        self.wall_base_us = start + int(args.clock_offset_s * 1e6)
+        self.wall_base_timer = self.timer(start)
+        self.outbox = []
+
+    def timer(self, host_us):
+        return int(host_us * (1 + self.drift)) + self.timer_offset_us
+
+    def host_at(self, timer_us):
+        return int((timer_us - self.timer_offset_us) / (1 + self.drift))
+
+    def wall(self, timer_us):
+        return self.wall_base_us + (timer_us - self.wall_base_timer)
+
+    def true_offset_us(self):
+        """Справжній зсув годинника логера від хоста (тільки в симуляції)"""
+        now = self.clock.now_us()
+        return self.wall(self.timer(now)) - now
+
+    def _latency(self, extra=0):
+        return self.delay_us + extra + random.uniform(0, self.jitter_us)
+
+    def _serialize_us(self, text):
+        return len(text.encode('utf-8')) * 10 * 1e6 / self.baud
+
+    def _send(self, timer_us, text):
+        deliver = self.host_at(timer_us) + self._serialize_us(text) + self._latency()
+        self.outbox.append((deliver, text))
+        self.outbox.sort()
+
+    def write_line(self, text):
+        arrival = self.clock.now_us() + self._serialize_us(text) + self._latency(self.asymmetry_us)
+        # Команду бачить тільки наступне опитування loop()
+        t2 = self.timer(arrival)
+        if self.poll_us > 0:
+            t2 += random.uniform(0, self.poll_us)
+        t2 = int(t2)
+        command = text.strip()
+
+        if command.startswith("sync"):
+            token = command[4:].strip()
+            t3 = t2 + 40
+            self._send(t3, f"[SYNC] {token} {t2} {t3} {self.wall(t3)}\n")
+        elif command.startswith("settime") and "@" in command:
+            stamp = command[8:27]
+            at_us = int(command.split("@", 1)[1])
+            unix_us = int((datetime.datetime.strptime(stamp, "%Y-%m-%d %H:%M:%S") - EPOCH).total_seconds()) * 1_000_000
+            # Прошивка округлює початок секунди вниз до мс, як millis() (fastTime.lastMillis)
+            self.wall_base_us = unix_us
+            self.wall_base_timer = at_us // 1000 * 1000
+            self._send(max(at_us, t2) + 300, f"[RTC] Час встановлено: {stamp} (межа секунди)\n")
+        else:
+            self._send(t2 + 40, "[SIM] Невідома команда\n")
+
+    def read_line(self, timeout):
+        deadline = self.clock.now_us() + int(timeout * 1e6)
+        if not self.outbox or self.outbox[0][0] > deadline:
+            time.sleep(timeout)
+            return None, None
+        deliver, text = self.outbox.pop(0)
+        # Спимо до ~1мс, решту чекаємо активно - інакше пробудження ОС додає асиметрію
+        while True:
+            left = deliver - self.clock.now_us()
+            if left <= 0:
+                break
+            if left > 2000:
+                time.sleep((left - 1500) / 1e6)
+        return text.strip(), self.clock.now_us()
+
+    def close(self):
+        pass
+
+
+class SyncSample:
+    def __init__(self, offset_us, rtt_us, wall_offset_us):
+        self.offset_us = offset_us          # Таймер логера мінус час хоста
+        self.rtt_us = rtt_us
+        self.wall_offset_us = wall_offset_us  # Годинник логера мінус час хоста (None без RTC)
+
+
+def probe(link, clock, baud, timeout=1.0):
+    """Одна NTP-подібна проба. None - немає відповіді (стара прошивка?)"""
+    t1 = clock.now_us()
+    token = str(t1)
+    request = f"sync {token}\n"
+    link.write_line(request)
+
+    # Між відповідями йдуть рядки логу - шукаємо свою, але не довше timeout
+    deadline = time.monotonic() + timeout
+    while True:
+        line, t4 = link.read_line(max(0.0, deadline - time.monotonic()))
+        if line is None:
+            return None
+        parts = line.split()
+        if len(parts) >= 5 and parts[0] == "[SYNC]" and parts[1] == token:
+            break
+
+    t2, t3, w3 = int(parts[2]), int(parts[3]), int(parts[4])
+    # Серіалізація на лінії: запит прийнято після останнього байта,
+    # відповідь почала передаватись у t3 - переносимо обидві мітки на кінець рядка
+    up_us = len(request) * 10 * 1e6 / baud
+    down_us = (len(line) + 1) * 10 * 1e6 / baud
+    t1 += up_us
+    t3_end = t3 + down_us
+
+    offset = ((t2 - t1) + (t3_end - t4)) / 2
+    rtt = (t4 - t1) - (t3_end - t2)
+    wall_offset = None
+    if w3 != 0:
+        w2 = w3 - (t3 - t2)
+        wall_offset = ((w2 - t1) + (w3 + down_us - t4)) / 2
+    return SyncSample(offset, rtt, wall_offset)
+
+
+def collect(link, clock, baud, count, pause_s=0.02):
+    samples = []
+    for _ in range(count):
+        sample = probe(link, clock, baud)
+        if sample is not None:
+            samples.append(sample)
+        time.sleep(random.uniform(0, pause_s))  # Різна фаза відносно опитування loop()
+    return samples
+
+
+def best_estimate(samples, key):
+    """Медіана серед чверті проб з найменшим RTT (NTP clock filter)"""
+    ranked = sorted((s for s in samples if key(s) is not None), key=lambda s: s.rtt_us)
+    if not ranked:
+        return None, None
+    best = ranked[:max(1, len(ranked) // 4)]
+    return statistics.median(key(s) for s in best), best[0].rtt_us
+
+
+def set_time(link, clock, offset_us, lead_s=0.5):
+    """Ставить час на найближчій межі секунди, не раніше ніж через lead_s"""
+    now = clock.now_us()
+    target = (now + int(lead_s * 1e6)) // 1_000_000 * 1_000_000 + 1_000_000
+    logger_at = int(round(target + offset_us))
+    stamp = (EPOCH + datetime.timedelta(microseconds=target)).strftime("%Y-%m-%d %H:%M:%S")
+
+    print(f"Встановлюємо {stamp} на таймері логера @{logger_at} мкс...")
+    link.write_line(f"settime {stamp} @{logger_at}\n")
+
+    deadline = time.monotonic() + lead_s + 3
+    while time.monotonic() < deadline:
+        line, _ = link.read_line(0.2)
+        if line is None:
+            continue
+        if line.startswith("[RTC]"):
+            print(f"ESP32: {line}")
+            return "встановлено" in line.lower()
+    return False
+
+
+def set_time_legacy(link, clock):
+    """Стара прошивка без sync: час з мілісекундами, логер вирівняє сам (або відкине мс)"""
+    now = clock.now_us()
+    stamp = EPOCH + datetime.timedelta(microseconds=now)
+    link.write_line(f"settime {stamp.strftime('%Y-%m-%d %H:%M:%S')}.{stamp.microsecond // 1000:03d}\n")
+    deadline = time.monotonic() + 3
+    while time.monotonic() < deadline:
+        line, _ = link.read_line(0.2)
+        if line and line.startswith("[RTC]"):
+            print(f"ESP32: {line}")
+            return "встановлено" in line.lower()
+    return False
+
+
+def synchronize(link, clock, args):
+    print(f"Проби синхронізації: {args.probes}...")
+    samples = collect(link, clock, args.baud, args.probes)
+    if not samples:
+        print("⚠️ Логер не відповідає на sync - стара прошивка? Встановлюємо час без проб")
+        return None if args.check else set_time_legacy(link, clock)
+
+    offset, min_rtt = best_estimate(samples, lambda s: s.offset_us)
+    print(f"Проб: {len(samples)}/{args.probes}, мін. RTT: {min_rtt / 1000:.3f} мс, "
+          f"медіана RTT: {statistics.median(s.rtt_us for s in samples) / 1000:.3f} мс")
+
+    wall_before, _ = best_estimate(samples, lambda s: s.wall_offset_us)
+    if wall_before is not None:
+        print(f"Зсув годинника логера до синхронізації: {wall_before / 1000:+.3f} мс")
+
+    if not args.check:
+        if not set_time(link, clock, offset):
+            print("⚠️ Не отримано підтвердження від ESP32")
+            return False
+
+    # Перевірка: годинник логера проти системного
+    samples = collect(link, clock, args.baud, args.probes)
+    achieved, min_rtt = best_estimate(samples, lambda s: s.wall_offset_us)
+    if achieved is None:
+        print("⚠️ Логер не повідомив свій час (RTC недоступний?)")
+        return False
+    print(f"✅ Досягнутий зсув: {achieved / 1000:+.3f} мс (похибка вимірювання ±{min_rtt / 2000:.3f} мс)")
+    return achieved
+
+
+def run_loopback(args):
+    clock = HostClock()
+    link = SimulatedLogger(clock, args)
+    print(f"=== Loopback: затримка {args.delay_ms} мс, джитер {args.jitter_ms} мс, "
+          f"асиметрія {args.asymmetry_ms} мс, опитування {args.poll_ms} мс, {args.baud} бод ===")
+
+    achieved = synchronize(link, clock, args)
+    if achieved is None or achieved is False:
+        return False
+
+    true_offset = link.true_offset_us()
+    print(f"Справжній зсув (симуляція): {true_offset / 1000:+.3f} мс, "
+          f"помилка оцінки: {(achieved - true_offset) / 1000:+.3f} мс")
+    # --check нічого не змінює - перевіряємо тільки точність оцінки
+    error = achieved - true_offset if args.check else true_offset
+    ok = abs(error) <= args.tolerance_ms * 1000
+    print("✅ У межах допуску" if ok else f"❌ Поза допуском ±{args.tolerance_ms} мс")
+    return ok
+
+
+def run_serial(args):
+    """Синхронізує годинник справжнього логера"""
     print("=== RTC Time Setter ===")
-    print("Встановлення системного часу на RTC годинник")
-    
+    print("Синхронізація системного часу з RTC годинником")
+
     # Знаходимо ESP32
-    port = find_esp32_port()
+    port = args.port or find_esp32_port()
     if not port:
         print("Не вдалося знайти ESP32. Переконайтеся що пристрій підключено.")
         return False
-    
+
     print(f"Підключення до {port}...")
-    
+    link = None
     try:
-        # Підключаємося до ESP32
-        ser = serial.Serial(port, 115200, timeout=2)
-        time.sleep(2)  # Чекаємо стабілізації з'єднання
-        
+        clock = HostClock()
+        link = SerialLink(port, args.baud, clock)
         print("Підключено!")
-        
-        # Очищуємо буфер
-        ser.flushInput()
-        ser.flushOutput()
-        
-        # Отримуємо поточний системний час
-        now = datetime.datetime.now()
-        time_str = now.strftime("%Y-%m-%d %H:%M:%S")
-        
-        print(f"Системний час: {time_str}")
-        print("Встановлюємо час на RTC...")
-        
-        # Формуємо команду для ESP32
-        command = f"settime {time_str}\n"
-        
-        # Відправляємо команду
-        ser.write(command.encode('utf-8'))
-        ser.flush()
-        
-        # Чекаємо відповідь
-        print("Очікуємо відповідь від ESP32...")
-        start_time = time.time()
-        
-        while time.time() - start_time < 5:  # Чекаємо до 5 секунд
-            if ser.in_waiting > 0:
-                response = ser.readline().decode('utf-8').strip()
-                print(f"ESP32: {response}")
-                
-                if "встановлено" in response.lower() or "час синхронізовано" in response.lower():
-                    print("✅ Час успішно встановлено!")
-                    
-                    # Перевіряємо встановлений час
-                    print("Перевіряємо встановлений час...")
-                    ser.write(b"gettime\n")
-                    ser.flush()
-                    time.sleep(0.5)
-                    
-                    if ser.in_waiting > 0:
-                        check_response = ser.readline().decode('utf-8').strip()
-                        print(f"Час на RTC: {check_response}")
-                    
-                    return True
-            
-            time.sleep(0.1)
-        
-        print("⚠️ Не отримано підтвердження від ESP32")
-        return False
-        
-    except serial.SerialException as e:
-        print(f"❌ Помилка підключення до порту {port}: {e}")
-        return False
+        achieved = synchronize(link, clock, args)
+        return achieved is not None and achieved is not False
     except Exception as e:
-        print(f"❌ Неочікувана помилка: {e}")
+        print(f"❌ Помилка: {e}")
         return False
     finally:
-        if 'ser' in locals():
-            ser.close()
+        if link is not None:
+            link.close()
             print("З'єднання закрито.")
 
+
 def main():
     """Головна функція"""
+    parser = argparse.ArgumentParser(description="Синхронізація RTC логера з системним часом")
+    parser.add_argument("--port", help="Послідовний порт (за замовчуванням - пошук ESP32)")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--probes", type=int, default=16, help="Кількість проб на оцінку")
+    parser.add_argument("--check", action="store_true", help="Тільки виміряти зсув, час не змінювати")
+    parser.add_argument("--no-pause", action="store_true", help="Не чекати Enter наприкінці")
+
+    sim = parser.add_argument_group("loopback (симульований логер)")
+    sim.add_argument("--loopback", action="store_true")
+    sim.add_argument("--delay-ms", type=float, default=2.0, help="Затримка USB-моста в один бік")
+    sim.add_argument("--jitter-ms", type=float, default=1.0)
+    sim.add_argument("--asymmetry-ms", type=float, default=0.0, help="Додаткова затримка запиту")
+    sim.add_argument("--poll-ms", type=float, default=1.0, help="Період опитування команд у loop()")
+    sim.add_argument("--drift-ppm", type=float, default=20.0)
+    sim.add_argument("--clock-offset-s", type=float, default=-1.7, help="Зсув годинника логера до синхронізації")
+    sim.add_argument("--tolerance-ms", type=float, default=1.0)
+    args = parser.parse_args()
+
     try:
-        success = set_rtc_time()
-        
+        if args.loopback:
+            return 0 if run_loopback(args) else 1
+
+        success = run_serial(args)
         if success:
             print("\n🎉 Операція завершена успішно!")
         else:
-            print("\n❌ Не вдалося встановити час на RTC")
-            
+            print("\n❌ Не вдалося синхронізувати час")
     except KeyboardInterrupt:
         print("\n⏹️ Операція перервана користувачем")
-    
-    input("\nНатисніть Enter для виходу...")
+        success = False
+
+    if not args.no_pause:
+        input("\nНатисніть Enter для виходу...")
+    return 0 if success else 1
+
 
 if __name__ == "__main__":
-    main()
+    sys.exit(main())
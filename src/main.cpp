@@ -23,6 +23,16 @@
 #include "FS.h"
 #include "SD.h"
 #include "SPI.h"
+#include "log_sink.h"
+#include "line_framer.h"
+#include "batch_controller.h"
+#include "line_dedup.h"
+#include "telemetry_store.h"
+#include "flight_recorder.h"
+#include "line_decimator.h"
+#include "usb_descriptors.h"
+#include "trace.h"
+#include "ingest_pipeline.h"
 
 // ESP-IDF includes для USB Host
 extern "C" {
@@ -31,6 +41,7 @@ extern "C" {
     #include "usb/usb_host.h"
     #include "driver/gpio.h"
     #include "class/cdc/cdc.h"
+    #include "esp_timer.h"
 }
 
 static const char* TAG = "USB_HOST";
@@ -51,24 +62,142 @@ usb_device_handle_t device_handle = NULL;
 // USB Host Client Handle
 usb_host_client_handle_t client_hdl;
 
-// Буфер для читання даних
+// Розмір одного USB transfer'а
 #define USB_BUFFER_SIZE 512
-uint8_t usb_buffer[USB_BUFFER_SIZE];
 
-// Буфер для накопичення даних до кінця рядка
-#define LINE_BUFFER_SIZE 16384  // 16KB для МАКСИМАЛЬНОЇ швидкості з 2 потоками!
-String lineBuffer = "";
+// КОНВЕЄР ПРИЙОМУ - склад і ємності фіксуються при компіляції (include/ingest_pipeline.h):
+// кільце USB -> framer -> проріджування -> телеметрія -> timestamp -> повтори -> блоки -> sink'и.
+// Тут - тільки відмінне від DefaultIngestConfig і ємності навколо конвеєра. Етап вимикається
+// рядком "static constexpr bool dedup = false;" - тоді не займає ні пам'яті, ні часу на рядок,
+// а його команда відповідає "не зібрано"
+struct LoggerPipelineConfig : DefaultIngestConfig {
+    // ПОТОКИ USB - кожен bulk IN складеного пристрою (dual-CDC, CDC + vendor trace)
+    // має ВЛАСНЕ кільце ringBytes, framer і пул transfer'ів
+    static constexpr int usbMaxStreams = 3;
+    static constexpr int usbTransfersPerStream = 2;      // Поки callback розбирає один transfer, інший уже приймає дані
+    // Потоки конвеєра з власним проріджуванням і повторами: 0 - події лінії "[USB] ", далі - usbStreams
+    static constexpr int streams = usbMaxStreams + 1;
 
-// АСИНХРОННИЙ SD БУФЕР для великих блоків
-#define SD_BUFFER_SIZE 8192   // 8KB буфер для SD
-String sdBuffer = "";
-bool sdBufferReady = false;   // Флаг готовності до запису
-uint32_t sdLinesInBuffer = 0; // Кількість рядків у SD буфері
+    // ЧЕРГИ SINK'ІВ - у блоках пулу. Кожен блок у черзі займає місце в пулі, тому пул рахується від них
+    static constexpr size_t serialQueueDepth = 8;
+    static constexpr size_t sdQueueDepth = 16;
+    static constexpr size_t telemetryQueueDepth = 8;
+    static constexpr size_t recorderQueueDepth = 16;
+    // Всі черги повні + по блоку в write() кожного sink'а + блок, який заповнює обробник: 53 блоки (212KB PSRAM)
+    static constexpr size_t blockCount = serialQueueDepth + sdQueueDepth + telemetryQueueDepth + recorderQueueDepth + MAX_SINKS + 1;
 
-// Глобальна змінна для endpoint
-uint8_t cdc_in_endpoint = 0;
+    // АДАПТИВНІ ПАЧКИ - розмір від заповнення кільця (4..512 рядків), 5мс CPU на цикл,
+    // під навантаженням пауза 1мс для watchdog, без даних - сон до сповіщення від USB
+    // (не довше 100мс), вище 50% заповнення кільця довго не чекаємо
+    static constexpr BatchConfig batch = { 4, 512, 5000, 1, 100, 50 };
+
+    static constexpr size_t recorderBytes = 4 * 1024 * 1024;  // 4MB передісторії самописця в PSRAM
+};
+
+// КІЛЬЦЕВИЙ БУФЕР USB -> обробник (без блокувань: один продюсер, один споживач)
+#define LINE_SEGMENT_DEFAULT 2048   // Довший рядок віддається сегментами з маркерами [...]
+#define LINE_IDLE_FLUSH_DEFAULT 0   // Мс тиші до видачі незавершеного рядка (0 - вимкнено)
+TaskHandle_t processorTaskHandle = NULL;  // USB callback будить обробник
+
+// ПОТОКИ USB - див. LoggerPipelineConfig::usbMaxStreams
+// Які bulk IN брати. USB_STREAM_OTHER (mass storage, аудіо, ...) - лише явно: це не консоль
+#define USB_STREAM_CLASSES (USB_STREAM_CDC_DATA | USB_STREAM_VENDOR)
+#define USB_STREAM_INTERFACES 0         // Маска номерів інтерфейсів (біт N - інтерфейс N), 0 - всі
+#define USB_NOTIFY_BUFFER_SIZE 64       // Сповіщення CDC (SERIAL_STATE - 10 байт)
+#define USB_EVENT_RING_SIZE 1024        // Події лінії (DCD/DSR/break) як рядки логу
+#define USB_EVENT_LINE_MAX 128
+
+struct UsbStream {
+    uint8_t ringStorage[LoggerPipelineConfig::ringBytes];
+    char framerStorage[LINE_FRAMER_BUFFER_SIZE(LoggerPipelineConfig::lineMaxLength)];
+    ByteRing ring;
+    LineFramer framer;
+    uint8_t endpoint;
+    uint8_t interfaceNumber;
+    char tag[12];                 // "[if2] " - тільки коли потоків кілька
+    volatile bool ended;          // Пристрій відключився - хвіст рядка треба віддати
+    uint32_t lastDroppedBytes;
+    
+    UsbStream() : ring(ringStorage, sizeof(ringStorage)), framer(framerStorage, sizeof(framerStorage)),
+                  endpoint(0), interfaceNumber(0), ended(false), lastDroppedBytes(0) {
+        tag[0] = '\0';
+    }
+};
+UsbStream usbStreams[LoggerPipelineConfig::usbMaxStreams];
+int usbStreamCount = 0;
+
+uint8_t usbEventRingStorage[USB_EVENT_RING_SIZE];
+ByteRing usbEventRing(usbEventRingStorage, USB_EVENT_RING_SIZE);
+char usbEventFramerStorage[LINE_FRAMER_BUFFER_SIZE(USB_EVENT_LINE_MAX)];
+LineFramer usbEventFramer(usbEventFramerStorage, sizeof(usbEventFramerStorage));
+
+// Transfer'и і інтерфейси поточного пристрою - звільняються, коли всі transfer'и повернулись
+usb_transfer_t *usbTransfers[LoggerPipelineConfig::usbMaxStreams * (LoggerPipelineConfig::usbTransfersPerStream + 1)];
+int usbTransferTotal = 0;
+volatile int usbTransfersInFlight = 0;
+uint8_t claimedInterfaces[USBDESC_MAX_INTERFACES];
+int claimedInterfaceCount = 0;
+volatile bool usbClosePending = false;
+
+// АДАПТИВНІ ПАЧКИ - параметри в LoggerPipelineConfig::batch
+BatchController batchController;
+
+// СПІЛЬНІ БЛОКИ РЯДКІВ для розсилки по sink'ах (SD, Serial, ...)
+LineBlockPool linePool;
+SinkFanout sinkFanout;
+int serialSinkIndex = -1;
+int sdSinkIndex = -1;
+
+// ЗГОРТАННЯ ПОВТОРІВ - heartbeat'и не пишемо на SD тисячі разів
+#define DEDUP_ENABLED_DEFAULT false
+#define DEDUP_FUZZY_DEFAULT false     // true - рядки, що відрізняються тільки числами, теж повтори
+#define DEDUP_MAX_HOLD_MS 10000       // Підсумок серії не пізніше ніж через 10с
+
+// ПРОРІДЖУВАННЯ - кГц потоки датчиків не забивають SD (для більшості прогонів досить 10 Гц)
+#define DECIMATION_PASSTHROUGH_DEFAULT false  // true - повна швидкість, правила не діють
+
+// Правила за префіксом рядка - підлаштуйте під свої пристрої
+const DecimationRule DECIMATION_RULES[] = {
+    { "$ADC,", DecimationMode::AGGREGATE, 100 },   // min/max/mean за 100мс (10 Гц)
+    { "$RAW,", DecimationMode::INTERVAL, 100 },    // не частіше одного рядка за 100мс
+    { "$DBG,", DecimationMode::EVERY_N, 100 },     // кожен 100-й рядок
+};
+
+// КОЛОНКОВА ТЕЛЕМЕТРІЯ - числові рядки йдуть у .tlm замість текстового логу
+#define TELEMETRY_ENABLED_DEFAULT false
+
+// Схеми телеметрії - підлаштуйте під свої пристрої.
+// KEY_VALUE без префікса бере лише рядки, що складаються тільки з ключів схеми
+const TelemetrySchema TELEMETRY_SCHEMAS[] = {
+    { "env", TelemetryFormat::KEY_VALUE, "", 2, 2, { "temp", "hum" } },
+    { "imu", TelemetryFormat::CSV, "$IMU,", 3, 3, { "ax", "ay", "az" } },
+};
+
+SinkFanout telemetryFanout;
+String currentTelemetryFile = "";
+uint32_t telemetryBlocksLost = 0;
+
+// БОРТОВИЙ САМОПИСЕЦЬ - останні МБ у PSRAM, на SD тільки вікно навколо тригера
+#define CAPTURE_MODE_DEFAULT false
+#define FR_POST_TRIGGER_MS 10000                  // Скільки писати після тригера
+#define FR_RATE_SPIKE_FACTOR 0                    // Тригер при сплеску швидкості в N разів (0 - ні)
+#define FR_RATE_MIN_BPS 1024                      // Аномалії шукаємо тільки від 1KB/s базової швидкості
+#define FR_STALL_MS 0                             // Тригер при тиші N мс після стабільного потоку (0 - ні)
+#define FR_DUMP_PERIOD_MS 20                      // Як часто потік вивантаження перевіряє тригер
+const char *FR_DEFAULT_PATTERNS[] = { "Guru Meditation", "panic", "assert failed" };
+FlightRecorder flightRecorder;
+int recorderSinkIndex = -1;
+bool captureMode = false;
+
+// ТРАСУВАННЯ ПОДІЙ - вмикається build_flags = -DLOGGER_TRACE, без нього коду немає зовсім.
+// Команда trace віддає кільця, trace_export.py перетворює їх на Chrome/Perfetto JSON
+#ifdef LOGGER_TRACE
+Tracer tracer;
+#endif
 
 // ШВИДКИЙ лічильник часу - БЕЗ звернень до RTC!
+// Пишуть і читають кілька задач (обробник - префікс рядків, loop - синхронізація
+// часу), тому всі поля - тільки під fastTimeMux, а назовні - копія
 struct FastTime {
     uint16_t year;
     uint8_t month;
@@ -79,10 +208,10 @@ struct FastTime {
     uint32_t lastMillis;
     uint32_t lastSyncMillis;  // Для синхронізації з RTC
 } fastTime;
+portMUX_TYPE fastTimeMux = portMUX_INITIALIZER_UNLOCKED;
 
-// ШВИДКЕ оновлення часу БЕЗ RTC
-void updateFastTime() {
-    uint32_t currentMillis = millis();
+// Просуває лічильник на цілі секунди. Викликати під fastTimeMux
+static void advanceFastTimeLocked(uint32_t currentMillis) {
     uint32_t elapsed = currentMillis - fastTime.lastMillis;
     
     // Оновлюємо тільки якщо пройшла хоча б секунда
@@ -106,19 +235,66 @@ void updateFastTime() {
                 }
             }
         }
-        
-        // РІДША синхронізація з RTC (раз на 5 хвилин)
-        if (rtc_working && (currentMillis - fastTime.lastSyncMillis > 300000)) {
-            DateTime now = rtc.now();
+    }
+}
+
+// Встановлює дату/час і початок поточної секунди
+void setFastTime(const DateTime &t, uint32_t secondStartMillis) {
+    portENTER_CRITICAL(&fastTimeMux);
+    fastTime.year = t.year();
+    fastTime.month = t.month();
+    fastTime.day = t.day();
+    fastTime.hour = t.hour();
+    fastTime.minute = t.minute();
+    fastTime.second = t.second();
+    fastTime.lastMillis = secondStartMillis;
+    fastTime.lastSyncMillis = millis();
+    portEXIT_CRITICAL(&fastTimeMux);
+}
+
+// Звірка з RTC переносить тільки цілі секунди: фаза секунди (lastMillis) лишається від
+// старту або settime. Читаємо DS1307 посередині своєї секунди, щоб межа секунди RTC,
+// близька до нашої, не дала зсуву на ±1 с
+#define RTC_RESYNC_MS 300000
+#define RTC_RESYNC_FROM_MS 250
+#define RTC_RESYNC_TO_MS 750
+
+// ШВИДКЕ оновлення часу БЕЗ RTC; повертає узгоджену копію.
+// millis() читається під блокуванням: інакше задача з давнішим millis() отримала б
+// lastMillis, який інша задача вже посунула далі, і різниця переповнилась би
+FastTime updateFastTime() {
+    portENTER_CRITICAL(&fastTimeMux);
+    uint32_t currentMillis = millis();
+    advanceFastTimeLocked(currentMillis);
+    // РІДША синхронізація з RTC (раз на 5 хвилин) - займає її одна задача
+    uint32_t inSecond = currentMillis - fastTime.lastMillis;
+    bool resync = rtc_working && (currentMillis - fastTime.lastSyncMillis > RTC_RESYNC_MS) &&
+                  inSecond >= RTC_RESYNC_FROM_MS && inSecond < RTC_RESYNC_TO_MS;
+    uint32_t phase = fastTime.lastMillis;
+    uint32_t prevSync = fastTime.lastSyncMillis;
+    if (resync) fastTime.lastSyncMillis = currentMillis;
+    FastTime snapshot = fastTime;
+    portEXIT_CRITICAL(&fastTimeMux);
+    
+    if (resync) {
+        // I2C - поза критичною секцією
+        DateTime now = rtc.now();
+        portENTER_CRITICAL(&fastTimeMux);
+        if (fastTime.lastMillis == phase && millis() - phase < 1000) {
             fastTime.year = now.year();
             fastTime.month = now.month();
             fastTime.day = now.day();
             fastTime.hour = now.hour();
             fastTime.minute = now.minute();
             fastTime.second = now.second();
-            fastTime.lastSyncMillis = currentMillis;
+            snapshot = fastTime;
+        } else if (fastTime.lastSyncMillis == currentMillis) {
+            // Поки читали RTC, минула межа секунди або час встановлено - наступного разу
+            fastTime.lastSyncMillis = prevSync;
         }
+        portEXIT_CRITICAL(&fastTimeMux);
     }
+    return snapshot;
 }
 
 // ШВИДКА функція для отримання часу - БЕЗ RTC звернень!
@@ -128,15 +304,73 @@ String getTimeString() {
     }
     
     // Оновлюємо час тільки якщо потрібно
-    updateFastTime();
+    FastTime t = updateFastTime();
     
     char buffer[25];
     sprintf(buffer, "[%02d.%02d.%04d %02d:%02d:%02d]", 
-            fastTime.day, fastTime.month, fastTime.year,
-            fastTime.hour, fastTime.minute, fastTime.second);
+            t.day, t.month, t.year,
+            t.hour, t.minute, t.second);
     return String(buffer);
 }
 
+// Timestamp-префікс рядків для конвеєра: форматуємо раз на секунду, а не для кожного рядка.
+// За штампом часу - тег потоку USB, з якого прийшов рядок
+class RtcClock {
+public:
+    RtcClock() : stampLen(0), len(0), tagText(""), secondMillis(0), secondUnixMs(0) { buf[0] = '\0'; }
+
+    const char *prefix() const { return buf; }
+    size_t length() const { return len; }
+
+    void setTag(const char *tag) {
+        tagText = tag;
+        size_t tagLen = strlen(tag);
+        if (stampLen + tagLen >= sizeof(buf)) tagLen = sizeof(buf) - 1 - stampLen;
+        memcpy(buf + stampLen, tag, tagLen);
+        len = stampLen + tagLen;
+        buf[len] = '\0';
+    }
+
+    void refresh() {
+        FastTime ft = updateFastTime();
+        if (stampLen > 0 && ft.lastMillis == secondMillis) return;
+        
+        // Є RTC чи ні - перевіряємо раз на секунду, а не на кожен рядок
+        if (rtc_working) {
+            stampLen = snprintf(buf, sizeof(buf), "[%02d.%02d.%04d %02d:%02d:%02d] ",
+                                ft.day, ft.month, ft.year,
+                                ft.hour, ft.minute, ft.second);
+            DateTime t(ft.year, ft.month, ft.day,
+                       ft.hour, ft.minute, ft.second);
+            secondUnixMs = (uint64_t)t.unixtime() * 1000ULL;
+        } else {
+            stampLen = snprintf(buf, sizeof(buf), "[NO_RTC] ");
+            secondUnixMs = ft.lastMillis;    // Без RTC колонка часу - millis()
+        }
+        secondMillis = ft.lastMillis;
+        setTag(tagText);
+    }
+
+    // Секунда змінилась - переформатовуємо префікс (інакше використовуємо готовий)
+    void tick(uint32_t nowMs) {
+        if (nowMs - secondMillis >= 1000) refresh();
+    }
+
+    // Час для колонки телеметрії: Unix мс з RTC, або millis() без RTC
+    uint64_t unixMs(uint32_t nowMs) const { return secondUnixMs + (nowMs - secondMillis); }
+
+private:
+    char buf[48];
+    size_t stampLen;
+    size_t len;
+    const char *tagText;
+    uint32_t secondMillis;     // fastTime.lastMillis на момент форматування
+    uint64_t secondUnixMs;
+};
+
+RtcClock rtcClock;
+IngestPipeline<LoggerPipelineConfig, RtcClock> ingest(rtcClock, linePool, sinkFanout);
+
 // Функція для створення нового файлу логів з назвою по поточній даті/часу
 String createLogFileName() {
     if (!rtc_working) {
@@ -152,18 +386,244 @@ String createLogFileName() {
     return String(filename);
 }
 
-// ШВИДКА буферизована функція для SD запису
-void writeToSD(String message) {
-    if (!sd_available || currentLogFile.length() == 0) return;
+// Sink для Serial - виводить блок одним write()
+class SerialSink : public LogSink {
+public:
+    const char *name() const override { return "serial"; }
+
+    bool write(const LineBlock &block) override {
+        return Serial.write((const uint8_t *)block.data, block.length) == block.length;
+    }
+};
+
+// Sink для SD - всі блоки пачки пишуться за одне відкриття файлу
+class SdSink : public LogSink {
+public:
+    SdSink(const char *sinkName, uint8_t traceFile)
+        : sinkName(sinkName), traceFile(traceFile), pathChanged(false) {
+        path[0] = '\0';
+        pendingPath[0] = '\0';
+    }
+
+    const char *name() const override { return sinkName; }
+
+    // Викликають setup() і loop() (newlog): шлях копіюється, sink підхопить його перед наступним записом.
+    // На String з loop() не посилаємось - його перепризначення звільняє буфер під ногами sink'а
+    void setPath(const String &filePath) {
+        char copy[sizeof(pendingPath)];
+        snprintf(copy, sizeof(copy), "%s", filePath.c_str());
+        portENTER_CRITICAL(&pathMux);
+        memcpy(pendingPath, copy, sizeof(pendingPath));
+        pathChanged.store(true);
+        portEXIT_CRITICAL(&pathMux);
+    }
+
+    // Sink увімкнений тільки поки є файл (updateSdSinks) - прапорці SD тут не перевіряємо
+    bool write(const LineBlock &block) override {
+        TRACE_EVENT(TRACE_SD_WRITE_BEGIN, traceFile, block.length);
+        if (pathChanged.exchange(false)) {
+            if (logFile) logFile.close();
+            portENTER_CRITICAL(&pathMux);
+            memcpy(path, pendingPath, sizeof(path));
+            portEXIT_CRITICAL(&pathMux);
+        }
+        if (!logFile) {
+            logFile = SD.open(path, FILE_APPEND);
+        }
+        bool ok = logFile && logFile.write((const uint8_t *)block.data, block.length) == block.length;
+        TRACE_EVENT(TRACE_SD_WRITE_END, traceFile, ok ? 1 : 0);
+        return ok;
+    }
+
+    void flush() override {
+        if (logFile) {
+            TRACE_EVENT(TRACE_SD_FLUSH_BEGIN, traceFile, 0);
+            logFile.flush();
+            logFile.close();
+            TRACE_EVENT(TRACE_SD_FLUSH_END, traceFile, 0);
+        }
+    }
+
+private:
+    const char *sinkName;
+    uint8_t traceFile;
+    char path[64];          // Належить потоку sink'а
+    char pendingPath[64];   // Новий шлях від setPath(), під pathMux
+    std::atomic<bool> pathChanged;
+    portMUX_TYPE pathMux = portMUX_INITIALIZER_UNLOCKED;
+    File logFile;
+};
+
+SerialSink serialSink;
+SdSink sdSink("sd", TRACE_SD_LOG);
+SdSink telemetrySink("telemetry", TRACE_SD_TELEMETRY);
+
+// Вікна самописця - кожне в окремий файл з часом і причиною тригера в назві
+class SdRecorderOutput : public FlightRecorderOutput {
+public:
+    bool open(const char *reason) override {
+        char filename[64];
+        if (rtc_working) {
+            DateTime now = rtc.now();
+            snprintf(filename, sizeof(filename), "/fr_%04d%02d%02d_%02d%02d%02d_%s.txt",
+                     now.year(), now.month(), now.day(),
+                     now.hour(), now.minute(), now.second(), reason);
+        } else {
+            snprintf(filename, sizeof(filename), "/fr_%lu_%s.txt", (unsigned long)millis(), reason);
+        }
+        captureFile = SD.open(filename, FILE_WRITE);
+        if (!captureFile) return false;
+        Serial.printf("[CAPTURE] Тригер '%s' - вивантаження у %s\n", reason, filename);
+        return true;
+    }
+
+    bool write(const char *data, size_t len) override {
+        return captureFile.write((const uint8_t *)data, len) == len;
+    }
+
+    void close() override {
+        captureFile.close();
+        Serial.println("[CAPTURE] Вікно записано, самописець знову чекає тригер");
+    }
+
+private:
+    File captureFile;
+};
+
+SdRecorderOutput recorderOutput;
+
+// Текстовий лог на SD пишеться, тільки коли файл створено і самописець вимкнено
+void updateSdSinks() {
+    sdSink.setPath(currentLogFile);
+    if (sdSinkIndex >= 0) sinkFanout.setEnabled(sdSinkIndex, !captureMode && currentLogFile.length() > 0);
+}
+
+// Режим самописця: текстовий лог на SD вимикається, працює тільки кільце
+void setCaptureMode(bool enabled) {
+    if (recorderSinkIndex < 0) return;
+    captureMode = enabled;
+    sinkFanout.setEnabled(recorderSinkIndex, enabled);
+    updateSdSinks();
+}
+
+// Готовий блок телеметрії - у власну чергу, щоб не змішувався з текстом
+void writeTelemetryBlock(const uint8_t *data, size_t len, void *ctx) {
+    LineBlock *block = linePool.acquire();
+    if (block == NULL) {
+        telemetryBlocksLost++;
+        return;
+    }
+    block->append(data, len);
+    telemetryFanout.publish(block);
+}
+
+// Створює .tlm поруч з текстовим логом і пише в нього опис схем
+void startTelemetryFile(const String &logFileName) {
+    String name = logFileName;
+    if (name.endsWith(".txt")) name = name.substring(0, name.length() - 4);
+    name += ".tlm";
+
+    TelemetryStore *telemetry = ingest.telemetry();
+    if (telemetry == NULL) return;
+
+    uint8_t header[512];
+    size_t headerLen = telemetry->writeHeader(header, sizeof(header));
+    File tlmFile = SD.open(name, FILE_WRITE);
+    if (tlmFile && headerLen > 0) {
+        tlmFile.write(header, headerLen);
+        tlmFile.close();
+        currentTelemetryFile = name;
+        Serial.printf("Файл телеметрії: %s\n", name.c_str());
+    } else {
+        Serial.println("Помилка створення файлу телеметрії!");
+        currentTelemetryFile = "";
+        telemetry->setEnabled(false);
+    }
+    telemetrySink.setPath(currentTelemetryFile);
+}
+
+// СИНХРОНІЗАЦІЯ ЧАСУ з хостом (NTP-подібні проби через Serial)
+#define COMMAND_MAX_LENGTH 128
+#define COMMAND_IDLE_MS 100            // Команда без '\n' завершується після тиші
+#define TIME_SET_MAX_AHEAD_US 10000000 // Запланувати встановлення часу можна не далі ніж на 10с
+
+// Настінний час RTC у мкс для моменту nowUs (esp_timer) - millis() рахує від того ж таймера
+int64_t getWallTimeUs(int64_t nowUs) {
+    if (!rtc_working) return 0;
+    FastTime ft = updateFastTime();
+    DateTime t(ft.year, ft.month, ft.day,
+               ft.hour, ft.minute, ft.second);
+    int32_t msInSecond = (int32_t)((uint32_t)(nowUs / 1000) - ft.lastMillis);
+    return (int64_t)t.unixtime() * 1000000LL + (int64_t)msInSecond * 1000 + nowUs % 1000;
+}
+
+// Встановлення часу, заплановане на мить atUs - межу секунди
+struct PendingTimeSet {
+    bool active;
+    int64_t atUs;
+    uint32_t unixtime;
+} pendingTimeSet = { false, 0, 0 };
+
+// Записує RTC рівно на межі секунди: DS1307 скидає дільник при записі секунд,
+// тому фаза RTC і швидкого лічильника збігаються з хостом
+void applyTimeSet(uint32_t unixtime, int64_t atUs) {
+    DateTime newTime(unixtime);
+    rtc.adjust(newTime);
+    int64_t lateUs = esp_timer_get_time() - atUs;
     
-    // Додаємо до SD буфера ШВИДКО
-    sdBuffer += message + "\n";
-    sdLinesInBuffer++;
+    // Секунда почалась у atUs, а не зараз. Округлення вниз, як у millis() - інакше
+    // lastMillis може випередити millis() і різниця в updateFastTime() переповниться
+    setFastTime(newTime, (uint32_t)(atUs / 1000));
     
-    // Позначаємо буфер готовим якщо він заповнений або пройшло багато часу
-    if (sdBuffer.length() >= SD_BUFFER_SIZE - 200 || sdLinesInBuffer >= 50) {
-        sdBufferReady = true;
+    Serial.printf("[RTC] Час встановлено: %04d-%02d-%02d %02d:%02d:%02d (межа секунди, запис RTC +%d мкс)\n",
+                  newTime.year(), newTime.month(), newTime.day(),
+                  newTime.hour(), newTime.minute(), newTime.second(), (int)lateUs);
+}
+
+// Виконує заплановане встановлення часу; останні мілісекунди дочікуємо точно
+void servicePendingTimeSet() {
+    if (!pendingTimeSet.active) return;
+    int64_t left = pendingTimeSet.atUs - esp_timer_get_time();
+    if (left > 2000) return;
+    if (left > 0) delayMicroseconds((uint32_t)left);
+    pendingTimeSet.active = false;
+    applyTimeSet(pendingTimeSet.unixtime, pendingTimeSet.atUs);
+}
+
+// НЕБЛОКУЮЧЕ читання команди замість readString() з його секундним timeout'ом.
+// Момент приходу рядка фіксуємо - це t2 для sync-проб
+char commandBuffer[COMMAND_MAX_LENGTH];
+size_t commandLength = 0;
+uint32_t commandLastByteMs = 0;
+int64_t commandRxUs = 0;
+
+bool readCommandLine(String &command) {
+    while (Serial.available() > 0) {
+        int ch = Serial.read();
+        if (ch < 0) break;
+        if (ch == '\n' || ch == '\r') {
+            if (commandLength == 0) continue;   // Друга половина "\r\n" або порожній рядок
+            commandRxUs = esp_timer_get_time();
+            commandBuffer[commandLength] = '\0';
+            commandLength = 0;
+            command = commandBuffer;
+            command.trim();
+            return true;
+        }
+        if (commandLength < COMMAND_MAX_LENGTH - 1) commandBuffer[commandLength++] = (char)ch;
+        commandLastByteMs = millis();
     }
+    
+    // Термінал без закінчення рядка - команда завершується тишею
+    if (commandLength > 0 && millis() - commandLastByteMs >= COMMAND_IDLE_MS) {
+        commandRxUs = esp_timer_get_time();
+        commandBuffer[commandLength] = '\0';
+        commandLength = 0;
+        command = commandBuffer;
+        command.trim();
+        return true;
+    }
+    return false;
 }
 
 // Глобальні змінні для профілювання USB
@@ -171,51 +631,143 @@ static uint32_t usbBytesReceived = 0;
 static uint32_t usbTransferCount = 0;
 static uint32_t lastUSBStatsTime = 0;
 
+// Transfer повернувся назавжди (пристрій зник або endpoint скинуто) - не перезапускаємо
+bool usb_transfer_retired(usb_transfer_t *transfer) {
+    if (transfer->status == USB_TRANSFER_STATUS_NO_DEVICE ||
+        transfer->status == USB_TRANSFER_STATUS_CANCELED) {
+        usbTransfersInFlight--;
+        return true;
+    }
+    return false;
+}
+
+// Перезапуск transfer'а; якщо не вдалося - він більше не в польоті
+void usb_transfer_resubmit(usb_transfer_t *transfer) {
+    if (usbClosePending || usb_host_transfer_submit(transfer) != ESP_OK) {
+        usbTransfersInFlight--;
+        TRACE_EVENT(TRACE_USB_RESUBMIT, transfer->bEndpointAddress, 1);
+        return;
+    }
+    TRACE_EVENT(TRACE_USB_RESUBMIT, transfer->bEndpointAddress, 0);
+}
+
 // Transfer callback - ТІЛЬКИ ЧИТАННЯ І ЗАПИС У БУФЕР з ПРОФІЛЮВАННЯМ!
 void usb_transfer_cb(usb_transfer_t *transfer) {
-    if (transfer->context != (void*)999) { 
-        if (transfer->status == USB_TRANSFER_STATUS_COMPLETED && transfer->actual_num_bytes > 0) {
-            
-            // Профілювання USB
-            usbBytesReceived += transfer->actual_num_bytes;
-            usbTransferCount++;
-            
-            // МАКСИМАЛЬНА ШВИДКІСТЬ - тільки додавання до буфера!
-            int bufLen = lineBuffer.length();
-            if (bufLen < LINE_BUFFER_SIZE - 100) {
-                // Додаємо дані швидко
-                for (int i = 0; i < transfer->actual_num_bytes; i++) {
-                    lineBuffer += (char)transfer->data_buffer[i];
-                }
-            }
+    if (usb_transfer_retired(transfer)) return;
+    
+    if (transfer->status == USB_TRANSFER_STATUS_COMPLETED && transfer->actual_num_bytes > 0) {
+        UsbStream *stream = (UsbStream *)transfer->context;
+        
+        // Профілювання USB
+        usbBytesReceived += transfer->actual_num_bytes;
+        usbTransferCount++;
+        
+        TRACE_EVENT(TRACE_USB_TRANSFER, transfer->bEndpointAddress, transfer->actual_num_bytes);
+        
+        // МАКСИМАЛЬНА ШВИДКІСТЬ - один memcpy у кільце потоку і сповіщення обробнику
+        size_t stored = stream->ring.write(transfer->data_buffer, transfer->actual_num_bytes);
+        if (stored < (size_t)transfer->actual_num_bytes) {
+            TRACE_EVENT(TRACE_OVERFLOW, TRACE_OVF_USB_RING, transfer->actual_num_bytes - stored);
+        }
+        if (processorTaskHandle != NULL) {
+            xTaskNotifyGive(processorTaskHandle);
+        }
+        
+        // Виводимо USB статистику кожні 10 секунд
+        uint32_t currentTime = millis();
+        if (lastUSBStatsTime == 0) lastUSBStatsTime = currentTime;
+        
+        if (currentTime - lastUSBStatsTime >= 10000) {
+            float bytesPerSec = (float)usbBytesReceived / ((currentTime - lastUSBStatsTime) / 1000.0f);
+            float transfersPerSec = (float)usbTransferCount / ((currentTime - lastUSBStatsTime) / 1000.0f);
             
-            // Виводимо USB статистику кожні 10 секунд
-            uint32_t currentTime = millis();
-            if (lastUSBStatsTime == 0) lastUSBStatsTime = currentTime;
+            Serial.println("=== USB ПРОФІЛЮВАННЯ ===");
+            Serial.printf("[USB] Отримано: %d байт за %d мс\n", usbBytesReceived, (currentTime - lastUSBStatsTime));
+            Serial.printf("[USB] Швидкість: %.1f байт/сек (%.2f KB/s)\n", bytesPerSec, bytesPerSec / 1024.0f);
+            Serial.printf("[USB] Transfer'ів: %d (%.1f/сек)\n", usbTransferCount, transfersPerSec);
+            Serial.printf("[USB] Середній розмір пакету: %.1f байт\n", (float)usbBytesReceived / usbTransferCount);
             
-            if (currentTime - lastUSBStatsTime >= 10000) {
-                float bytesPerSec = (float)usbBytesReceived / ((currentTime - lastUSBStatsTime) / 1000.0f);
-                float transfersPerSec = (float)usbTransferCount / ((currentTime - lastUSBStatsTime) / 1000.0f);
-                
-                Serial.println("=== USB ПРОФІЛЮВАННЯ ===");
-                Serial.printf("[USB] Отримано: %d байт за %d мс\n", usbBytesReceived, (currentTime - lastUSBStatsTime));
-                Serial.printf("[USB] Швидкість: %.1f байт/сек (%.2f KB/s)\n", bytesPerSec, bytesPerSec / 1024.0f);
-                Serial.printf("[USB] Transfer'ів: %d (%.1f/сек)\n", usbTransferCount, transfersPerSec);
-                Serial.printf("[USB] Середній розмір пакету: %.1f байт\n", (float)usbBytesReceived / usbTransferCount);
-                
-                // Скидаємо лічильники
-                usbBytesReceived = 0;
-                usbTransferCount = 0;
-                lastUSBStatsTime = currentTime;
-            }
+            // Скидаємо лічильники
+            usbBytesReceived = 0;
+            usbTransferCount = 0;
+            lastUSBStatsTime = currentTime;
+        }
+    }
+    
+    // Миттєвий перезапуск
+    usb_transfer_resubmit(transfer);
+}
+
+// Сповіщення CDC (interrupt IN) - зміни DCD/DSR, break, помилки лінії йдуть у лог
+void usb_notify_cb(usb_transfer_t *transfer) {
+    if (usb_transfer_retired(transfer)) return;
+    
+    CdcNotification notification;
+    if (transfer->status == USB_TRANSFER_STATUS_COMPLETED &&
+        parseCdcNotification(transfer->data_buffer, transfer->actual_num_bytes, notification)) {
+        char line[USB_EVENT_LINE_MAX];
+        size_t len = formatCdcNotification(notification, line, sizeof(line) - 1);
+        line[len++] = '\n';
+        // Всі callback'и викликає один потік USB Host - кільце подій має одного продюсера
+        usbEventRing.write((const uint8_t *)line, len);
+        if (processorTaskHandle != NULL) {
+            xTaskNotifyGive(processorTaskHandle);
+        }
+    }
+    usb_transfer_resubmit(transfer);
+}
+
+// Сумарна статистика framer'ів усіх потоків
+FramerStats framerStatsTotal() {
+    FramerStats total = usbEventFramer.stats();
+    for (int i = 0; i < LoggerPipelineConfig::usbMaxStreams; i++) {
+        const FramerStats &f = usbStreams[i].framer.stats();
+        total.lines += f.lines;
+        total.bytes += f.bytes;
+        total.zeroCopyLines += f.zeroCopyLines;
+        total.segments += f.segments;
+        total.idleFlushes += f.idleFlushes;
+        total.cutLines += f.cutLines;
+    }
+    return total;
+}
+
+// Повтори і проріджування - окремі в кожному потоці конвеєра
+DedupStats dedupStatsTotal() {
+    DedupStats total = {};
+    for (int s = 0; s < ingest.streams(); s++) {
+        if (LineDedup *dedup = ingest.dedup(s)) {
+            const DedupStats &d = dedup->stats();
+            total.linesIn += d.linesIn;
+            total.linesSuppressed += d.linesSuppressed;
+            total.summaries += d.summaries;
+            total.bytesSuppressed += d.bytesSuppressed;
+            total.summaryBytes += d.summaryBytes;
+        }
+    }
+    return total;
+}
+
+DecimationStats decimationStatsTotal() {
+    DecimationStats total = {};
+    for (int s = 0; s < ingest.streams(); s++) {
+        if (LineDecimator *decimator = ingest.decimator(s)) {
+            const DecimationStats &d = decimator->stats();
+            total.linesIn += d.linesIn;
+            total.linesPassed += d.linesPassed;
+            total.aggregates += d.aggregates;
         }
-        
-        // Миттєвий перезапуск
-        usb_host_transfer_submit(transfer);
     }
+    return total;
 }
 
-// БЕЗПЕЧНИЙ ПОТІК для обробки буфера з ПРОФІЛЮВАННЯМ
+uint32_t framerBytesTotal() {
+    uint32_t bytes = usbEventFramer.stats().bytes;
+    for (int i = 0; i < LoggerPipelineConfig::usbMaxStreams; i++) bytes += usbStreams[i].framer.stats().bytes;
+    return bytes;
+}
+
+// ПОТІК ОБРОБКИ БУФЕРА - адаптивні пачки з бюджетом часу і ПРОФІЛЮВАННЯМ
 void buffer_processor_task(void *arg) {
     Serial.println("[BUFFER] Потік обробки буфера запущено!");
     
@@ -223,367 +775,386 @@ void buffer_processor_task(void *arg) {
     uint32_t lastStatsTime = millis();
     uint32_t totalProcessedLines = 0;
     uint32_t cycleCount = 0;
-    uint32_t timeInIndexOf = 0;
-    uint32_t timeInSubstring = 0;
-    uint32_t timeInReplace = 0;
-    uint32_t timeInSerial = 0;
-    uint32_t timeInSD = 0;
+    uint32_t totalCycleTime = 0;
+    uint32_t timeInDrain = 0;
+    uint32_t timeInPoll = 0;
+    int firstStream = 0;          // По колу - зайнятий потік не голодить інші
     
     while (true) {
         uint32_t cycleStart = micros();
+        auto withinBudget = [cycleStart]() { return batchController.withinBudget(cycleStart); };
         
-        // Обробляємо буфер невеликими порціями щоб не викликати Watchdog
-        if (lineBuffer.length() > 0) {
-            int processedLines = 0;
-            
-            // Обробляємо тільки 10 рядків за раз для БЕЗПЕКИ
-            while (processedLines < 10 && lineBuffer.length() > 0) {
-                uint32_t t1 = micros();
-                int newlinePos = lineBuffer.indexOf('\n');
-                uint32_t t2 = micros();
-                timeInIndexOf += (t2 - t1);
-                
-                if (newlinePos == -1) break; // Немає повних рядків
-                
-                // Отримуємо повний рядок
-                t1 = micros();
-                String completeLine = lineBuffer.substring(0, newlinePos);
-                lineBuffer = lineBuffer.substring(newlinePos + 1);
-                t2 = micros();
-                timeInSubstring += (t2 - t1);
-                
-                // Швидка обробка та вивід
-                if (completeLine.length() > 0) {
-                    t1 = micros();
-                    completeLine.replace("\r", ""); // Прибираємо \r
-                    t2 = micros();
-                    timeInReplace += (t2 - t1);
-                    
-                    // ПРЯМИЙ вивід БЕЗ timestamp - МАКСИМАЛЬНА швидкість!
-                    t1 = micros();
-                    Serial.println(completeLine);
-                    t2 = micros();
-                    timeInSerial += (t2 - t1);
-                    
-                    // АСИНХРОННИЙ SD запис - НЕ блокує обробку!
-                    if (sd_available && currentLogFile.length() > 0) {
-                        t1 = micros();
-                        String timeStr = getTimeString(); // Швидкий час
-                        String fullMessage = timeStr + " " + completeLine;
-                        writeToSD(fullMessage); // Тепер це ШВИДКО - тільки додавання до буфера!
-                        t2 = micros();
-                        timeInSD += (t2 - t1);
-                    }
-                }
-                
-                processedLines++;
-                totalProcessedLines++;
-                
-                // Мікро-пауза після кожних 5 рядків для Watchdog
-                if (processedLines % 5 == 0) {
-                    vTaskDelay(pdMS_TO_TICKS(1)); // 1мс пауза для reset watchdog
-                }
+        // Розмір пачки - від заповнення кілець і бюджету часу
+        size_t fill = usbEventRing.size();
+        size_t maxFill = 0;
+        for (int i = 0; i < LoggerPipelineConfig::usbMaxStreams; i++) {
+            size_t streamFill = usbStreams[i].ring.size();
+            fill += streamFill;
+            if (streamFill > maxFill) maxFill = streamFill;
+        }
+        uint32_t limit = batchController.beginCycle(fill);
+        TRACE_EVENT(TRACE_BATCH_BEGIN, 0, limit);
+        
+        // Timestamp і блок - один раз на пачку
+        ingest.beginBatch(fill, limit);
+        
+        uint32_t processedLines = 0;
+        uint32_t bytesBefore = framerBytesTotal();
+        
+        // Події лінії - першими, їх мало і вони пояснюють дані навколо
+        bool drained;
+        processedLines += ingest.drain(0, usbEventRing, usbEventFramer, "[USB] ", limit, withinBudget, drained);
+        for (int n = 0; n < LoggerPipelineConfig::usbMaxStreams; n++) {
+            int index = (firstStream + n) % LoggerPipelineConfig::usbMaxStreams;
+            UsbStream &stream = usbStreams[index];
+            bool streamDrained;
+            processedLines += ingest.drain(index + 1, stream.ring, stream.framer, stream.tag, limit - processedLines,
+                                           withinBudget, streamDrained);
+            if (!streamDrained) {
+                drained = false;
+                continue;
             }
-            
-            // Захист від переповнення
-            if (lineBuffer.length() > LINE_BUFFER_SIZE - 3000) {
-                Serial.println("[БУФЕР-ПЕРЕПОВНЕННЯ]");
-                lineBuffer = "";
+            // Пристрій відключився посеред рядка - віддаємо хвіст з маркером [CUT]
+            if (stream.ended) {
+                stream.ended = false;
+                ingest.finish(index + 1, stream.framer, stream.tag);
+            }
+        }
+        firstStream = (firstStream + 1) % LoggerPipelineConfig::usbMaxStreams;
+        timeInDrain += micros() - cycleStart;
+        
+        uint32_t processedBytes = framerBytesTotal() - bytesBefore;
+        totalProcessedLines += processedLines;
+        
+        // Переповнення кільця - USB дані не влізли
+        for (int i = 0; i < LoggerPipelineConfig::usbMaxStreams; i++) {
+            UsbStream &stream = usbStreams[i];
+            if (stream.ring.droppedBytes() != stream.lastDroppedBytes) {
+                Serial.printf("[БУФЕР-ПЕРЕПОВНЕННЯ] Потік %s втратив %d байт USB\n", stream.tag,
+                              stream.ring.droppedBytes() - stream.lastDroppedBytes);
+                stream.lastDroppedBytes = stream.ring.droppedBytes();
             }
         }
         
+        // Вікна агрегації, серії повторів, телеметрія і неповний блок
+        uint32_t t1 = micros();
+        ingest.poll(millis());
+        timeInPoll += micros() - t1;
+        
+        TRACE_EVENT(TRACE_BATCH_END, 0, processedLines);
         cycleCount++;
-        uint32_t cycleEnd = micros();
-        uint32_t cycleTime = cycleEnd - cycleStart;
+        uint32_t cycleTime = micros() - cycleStart;
+        totalCycleTime += cycleTime;
+        uint32_t waitMs = batchController.endCycle(processedLines, processedBytes, cycleTime,
+                                                   drained, maxFill, LoggerPipelineConfig::ringBytes);
+        
+        // Неповний блок має піти не пізніше blockFlushMs - не спимо довше
+        waitMs = ingest.writer().maxWaitMs(millis(), waitMs);
         
         // Виводимо статистику кожні 5 секунд
         uint32_t currentTime = millis();
         if (currentTime - lastStatsTime >= 5000) {
             float frequency = (float)totalProcessedLines / ((currentTime - lastStatsTime) / 1000.0f);
-            float avgCycleTime = (float)cycleTime / cycleCount;
+            float avgCycleTime = (float)totalCycleTime / cycleCount;
+            const BatchStats &b = batchController.stats();
+            FramerStats f = framerStatsTotal();
             
             Serial.println("=== ПРОФІЛЮВАННЯ БУФЕРА ===");
             Serial.printf("[PERF] Оброблено рядків: %d за %d мс\n", totalProcessedLines, (currentTime - lastStatsTime));
             Serial.printf("[PERF] Частота обробки: %.2f рядків/сек\n", frequency);
-            Serial.printf("[PERF] Розмір буфера: %d/%d байт (%.1f%%)\n", 
-                         lineBuffer.length(), LINE_BUFFER_SIZE, 
-                         (float)lineBuffer.length() / LINE_BUFFER_SIZE * 100.0f);
-            Serial.printf("[PERF] Циклів: %d, Сер. час циклу: %.1f мкс\n", cycleCount, avgCycleTime);
+            for (int i = 0; i < usbStreamCount; i++) {
+                UsbStream &stream = usbStreams[i];
+                Serial.printf("[PERF] Кільце EP 0x%02X: %d/%d байт (%d%%), втрачено: %d байт\n",
+                             stream.endpoint, stream.ring.size(), stream.ring.capacity(),
+                             stream.ring.fillPercent(), stream.ring.droppedBytes());
+            }
+            Serial.printf("[PERF] Циклів: %d, Сер. час циклу: %.1f мкс, макс: %d мкс\n",
+                         cycleCount, avgCycleTime, b.maxCycleUs);
+            Serial.printf("[PERF] Пачки: макс. %d рядків, під навантаженням: %d, понад бюджет: %d\n",
+                         b.maxBatch, b.busyCycles, b.budgetOverruns);
+            Serial.printf("[PERF] Рядок: ~%d мкс, ~%d байт, без копіювання: %d/%d\n",
+                         batchController.avgLineUs(), batchController.avgLineBytes(), f.zeroCopyLines, f.lines);
+            if (f.segments > 0 || f.idleFlushes > 0 || f.cutLines > 0) {
+                Serial.printf("[PERF] Довгі рядки: %d сегментів, %d по тиші, %d обірвано\n",
+                             f.segments, f.idleFlushes, f.cutLines);
+            }
             
             // Розподіл часу по операціях (в мікросекундах)
             Serial.println("[PERF] Час по операціях (мкс):");
-            Serial.printf("  indexOf: %d, substring: %d, replace: %d\n", timeInIndexOf, timeInSubstring, timeInReplace);
-            Serial.printf("  Serial: %d, SD: %d\n", timeInSerial, timeInSD);
+            Serial.printf("  прийом рядків: %d, обслуговування: %d, решта: %d\n",
+                         timeInDrain, timeInPoll, totalCycleTime - timeInDrain - timeInPoll);
+            Serial.printf("[PERF] Вільних блоків: %d/%d, втрачено рядків без блоку: %d\n",
+                         linePool.available(), linePool.size(), ingest.writer().linesLost());
             
             // Скидаємо лічильники
             lastStatsTime = currentTime;
             totalProcessedLines = 0;
             cycleCount = 0;
-            timeInIndexOf = timeInSubstring = timeInReplace = timeInSerial = timeInSD = 0;
+            totalCycleTime = timeInDrain = timeInPoll = 0;
+            batchController.resetStats();
+            for (int i = 0; i < LoggerPipelineConfig::usbMaxStreams; i++) usbStreams[i].framer.resetStats();
+            usbEventFramer.resetStats();
         }
         
-        // БІЛЬШИЙ delay для безпеки Watchdog
-        vTaskDelay(pdMS_TO_TICKS(10)); // 10мс delay для стабільності
+        // Під навантаженням - мінімальна пауза (watchdog), без даних - чекаємо сповіщення від USB
+        if (waitMs <= LoggerPipelineConfig::batch.busyWaitMs) {
+            vTaskDelay(pdMS_TO_TICKS(LoggerPipelineConfig::batch.busyWaitMs));
+        } else {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+        }
     }
 }
 
-// АСИНХРОННИЙ SD ПОТІК - запис великими блоками БЕЗ блокування системи
-void sd_writer_task(void *arg) {
-    Serial.println("[SD] Асинхронний SD потік запущено!");
+// Параметри потоку sink'а: яка розсилка, який індекс, як часто обслуговувати
+struct SinkTask {
+    SinkFanout *fanout;
+    int index;
+    uint32_t periodMs;
+};
+SinkTask sinkTasks[2 * MAX_SINKS];
+int sinkTaskCount = 0;
+
+// ПОТІК SINK'А - один на кожен вихід, повільний sink не гальмує інші
+void sink_writer_task(void *arg) {
+    SinkTask *task = (SinkTask *)arg;
+    SinkFanout &fanout = *task->fanout;
+    int index = task->index;
+    LogSink *sink = fanout.sink(index);
+    Serial.printf("[SINK] Потік '%s' запущено (черга %d, політика %s)\n",
+                 sink->name(), fanout.depth(index),
+                 overflowPolicyName(fanout.policy(index)));
     
-    uint32_t lastForceWrite = millis();
-    uint32_t totalBytesWritten = 0;
-    uint32_t totalLinesWritten = 0;
-    uint32_t writeOperations = 0;
     uint32_t lastStatsTime = millis();
     
     while (true) {
-        uint32_t currentTime = millis();
+        // Записуємо все, що накопичилось у черзі, однією пачкою
+        fanout.service(index);
         
-        // Перевіряємо чи потрібно записувати
-        bool shouldWrite = false;
-        
-        if (sdBufferReady) {
-            shouldWrite = true; // Буфер заповнений
-        } else if (sdBuffer.length() > 0 && (currentTime - lastForceWrite > 5000)) {
-            shouldWrite = true; // Примусовий запис кожні 5 секунд
-        }
-        
-        if (shouldWrite && sd_available && currentLogFile.length() > 0) {
-            uint32_t writeStart = micros();
-            
-            // Копіюємо дані для запису і очищуємо буфер ШВИДКО
-            String dataToWrite = sdBuffer;
-            uint32_t linesToWrite = sdLinesInBuffer;
-            sdBuffer = "";
-            sdBuffer.reserve(SD_BUFFER_SIZE); // Резервуємо пам'ять
-            sdLinesInBuffer = 0;
-            sdBufferReady = false;
-            
-            // Виконуємо ДОВГИЙ запис на SD (не блокує інші потоки!)
-            File logFile = SD.open(currentLogFile, FILE_APPEND);
-            if (logFile) {
-                logFile.print(dataToWrite); // Записуємо великий блок ОДРАЗУ
-                logFile.flush();
-                logFile.close();
-                
-                // Статистика
-                uint32_t writeTime = micros() - writeStart;
-                totalBytesWritten += dataToWrite.length();
-                totalLinesWritten += linesToWrite;
-                writeOperations++;
-                
-                Serial.printf("[SD] Записано %d байт (%d рядків) за %d мкс\n", 
-                             dataToWrite.length(), linesToWrite, writeTime);
-            }
-            
-            lastForceWrite = currentTime;
-        }
-        
-        // Виводимо SD статистику кожні 30 секунд
+        // Виводимо статистику sink'а кожні 30 секунд
+        uint32_t currentTime = millis();
         if (currentTime - lastStatsTime >= 30000) {
-            float avgBytesPerWrite = writeOperations > 0 ? (float)totalBytesWritten / writeOperations : 0;
-            float avgLinesPerWrite = writeOperations > 0 ? (float)totalLinesWritten / writeOperations : 0;
+            SinkMetrics m = fanout.metrics(index);
+            float avgBytesPerBlock = m.blocksWritten > 0 ? (float)m.bytesWritten / m.blocksWritten : 0;
             
-            Serial.println("=== SD СТАТИСТИКА ===");
-            Serial.printf("[SD] Записано: %d байт, %d рядків\n", totalBytesWritten, totalLinesWritten);
-            Serial.printf("[SD] Операцій запису: %d\n", writeOperations);
-            Serial.printf("[SD] Середній розмір блоку: %.1f байт (%.1f рядків)\n", 
-                         avgBytesPerWrite, avgLinesPerWrite);
-            Serial.printf("[SD] У буфері зараз: %d байт (%d рядків)\n", 
-                         sdBuffer.length(), sdLinesInBuffer);
+            Serial.printf("=== SINK '%s' СТАТИСТИКА ===\n", sink->name());
+            Serial.printf("[SINK] Записано: %d байт, %d рядків, %d блоків (%.1f байт/блок)\n",
+                         m.bytesWritten, m.linesWritten, m.blocksWritten, avgBytesPerBlock);
+            Serial.printf("[SINK] Втрачено: %d блоків, %d рядків, помилок запису: %d\n",
+                         m.blocksDropped, m.linesDropped, m.writeErrors);
+            Serial.printf("[SINK] Черга: %d/%d (макс. %d), час запису: %d мкс (макс. %d)\n",
+                         fanout.queued(index), fanout.depth(index), m.maxDepth,
+                         m.writeTimeUs, m.maxWriteUs);
             
-            // Скидаємо статистику
-            totalBytesWritten = totalLinesWritten = writeOperations = 0;
+            fanout.resetMetrics(index);
             lastStatsTime = currentTime;
         }
         
-        // SD потік працює рідше - не перешкоджає USB
-        vTaskDelay(pdMS_TO_TICKS(100)); // 100мс delay
+        vTaskDelay(pdMS_TO_TICKS(task->periodMs));
     }
 }
 
-// Простий callback для синхронних transfer з активної задачі
-void sync_transfer_cb(usb_transfer_t *transfer) {
-    // Просто позначаємо що transfer завершено
-    // Основна логіка в cdc_reader_task - тут нічого не робимо
+// Вивантаження вікна самописця на SD - окремо від його sink'а, щоб запис
+// на повільну карту не тримав чергу блоків (і пул) зайнятими
+void recorder_dump_task(void *arg) {
+    while (true) {
+        bool more = flightRecorder.dump(millis());
+        vTaskDelay(pdMS_TO_TICKS(more ? 1 : FR_DUMP_PERIOD_MS));
+    }
+}
+
+// Реєструє sink і запускає для нього окремий потік
+int start_sink(SinkFanout &fanout, LogSink *sink, size_t depth, OverflowPolicy policy,
+               uint32_t blockTimeoutMs, uint32_t periodMs, UBaseType_t priority) {
+    int index = fanout.add(sink, depth, policy, blockTimeoutMs);
+    if (index < 0 || sinkTaskCount >= 2 * MAX_SINKS) {
+        Serial.printf("[SINK] Немає місця для sink'а '%s'\n", sink->name());
+        return -1;
+    }
+    SinkTask *task = &sinkTasks[sinkTaskCount++];
+    task->fanout = &fanout;
+    task->index = index;
+    task->periodMs = periodMs;
+    xTaskCreate(sink_writer_task, sink->name(), 4096, task, priority, NULL);
+    return index;
 }
 
-// Активна задача для читання (ЄДИНИЙ спосіб читання) - З БУФЕРИЗАЦІЄЮ
-void cdc_reader_task(void *arg) {
-    Serial.println("[CDC READER] ЄДИНА активна задача запущена");
+// Виділяє transfer на endpoint і запускає його. false - не вдалося
+bool start_usb_transfer(usb_device_handle_t dev_hdl, uint8_t endpoint, size_t size,
+                        usb_transfer_cb_t callback, void *context) {
+    if (usbTransferTotal >= (int)(sizeof(usbTransfers) / sizeof(usbTransfers[0]))) return false;
     
-    while (true) {
-        if (device_handle != NULL && cdc_in_endpoint != 0) {
-            // Створюємо transfer для читання
-            usb_transfer_t *read_transfer;
-            esp_err_t err = usb_host_transfer_alloc(64, 0, &read_transfer);
-            if (err == ESP_OK) {
-                read_transfer->device_handle = device_handle;
-                read_transfer->bEndpointAddress = cdc_in_endpoint;
-                read_transfer->callback = sync_transfer_cb;
-                read_transfer->context = (void*)999; // Маркер активної задачі
-                read_transfer->num_bytes = 64;
-                read_transfer->timeout_ms = 10; // ШВИДКИЙ timeout для реального часу
-                
-                // Запускаємо transfer
-                err = usb_host_transfer_submit(read_transfer);
-                if (err == ESP_OK) {
-                    // Чекаємо завершення з мінімальним timeout для реального часу
-                    usb_host_client_handle_events(client_hdl, 20);
-                    
-                    if (read_transfer->status == USB_TRANSFER_STATUS_COMPLETED && 
-                        read_transfer->actual_num_bytes > 0) {
-                        
-                        // ВІДКЛЮЧЕНО: обробка тут створює race condition з callback
-                        // Всі дані тепер обробляються тільки через usb_transfer_cb callback
-                        /*
-                        // Обробляємо отримані дані з буферизацією
-                        for (int i = 0; i < read_transfer->actual_num_bytes; i++) {
-                            char ch = (char)read_transfer->data_buffer[i];
-                            
-                            if (ch == '\n') {
-                                // Знайдено кінець рядка - виводимо повний рядок з часом
-                                String timeStr = getTimeString();
-                                String fullMessage = timeStr + " " + lineBuffer;
-                                Serial.println(fullMessage);
-                                writeToSD(fullMessage); // Записуємо на SD
-                                lineBuffer = ""; // Очищуємо буфер
-                            } else if (ch == '\r') {
-                                // Ігноруємо \r
-                                continue;
-                            } else {
-                                // Додаємо символ до буфера
-                                lineBuffer += ch;
-                                
-                                // Захист від переповнення буфера
-                                if (lineBuffer.length() > LINE_BUFFER_SIZE - 10) {
-                                    String timeStr = getTimeString();
-                                    String fullMessage = timeStr + " " + lineBuffer + " [ОБРІЗАНО]";
-                                    Serial.println(fullMessage);
-                                    writeToSD(fullMessage); // Записуємо на SD
-                                    lineBuffer = "";
-                                }
-                            }
-                        }
-                        */
-                    }
-                } else {
-                    Serial.printf("[READER] Transfer submit failed: %s\n", esp_err_to_name(err));
-                }
-                
-                // Завжди звільняємо transfer
-                usb_host_transfer_free(read_transfer);
-            } else {
-                Serial.printf("[READER] Transfer alloc failed: %s\n", esp_err_to_name(err));
-            }
-            
-            // МІНІМАЛЬНА затримка для реального часу (1мс = 1000 Hz!)
-            vTaskDelay(pdMS_TO_TICKS(1));
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(100)); // Коли немає пристрою - чекаємо довше
-        }
+    usb_transfer_t *transfer;
+    esp_err_t err = usb_host_transfer_alloc(size, 0, &transfer);
+    if (err != ESP_OK) {
+        Serial.printf("[CDC] Помилка створення transfer: %s\n", esp_err_to_name(err));
+        return false;
+    }
+    transfer->device_handle = dev_hdl;
+    transfer->bEndpointAddress = endpoint;
+    transfer->callback = callback;
+    transfer->context = context;
+    transfer->num_bytes = size;
+    transfer->timeout_ms = 10; // Швидкий timeout
+    usbTransfers[usbTransferTotal++] = transfer;
+    
+    // Лічильник міняють тільки callback'и і події клієнта - все в потоці USB Host
+    usbTransfersInFlight++;
+    err = usb_host_transfer_submit(transfer);
+    if (err != ESP_OK) {
+        usbTransfersInFlight--;
+        Serial.printf("[CDC] Помилка запуску transfer на EP 0x%02X: %s\n", endpoint, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// Відкриває інтерфейс один раз, навіть якщо з нього беремо кілька endpoint'ів
+bool claim_usb_interface(usb_device_handle_t dev_hdl, uint8_t number) {
+    for (int i = 0; i < claimedInterfaceCount; i++) {
+        if (claimedInterfaces[i] == number) return true;
     }
+    if (claimedInterfaceCount >= USBDESC_MAX_INTERFACES) return false;
+    
+    esp_err_t err = usb_host_interface_claim(client_hdl, dev_hdl, number, 0);
+    if (err != ESP_OK) {
+        Serial.printf("[CDC] Помилка відкриття інтерфейсу %d: %s\n", number, esp_err_to_name(err));
+        return false;
+    }
+    claimedInterfaces[claimedInterfaceCount++] = number;
+    Serial.printf("[CDC] Інтерфейс %d успішно відкрито\n", number);
+    return true;
 }
 
-// Функція для налаштування CDC читання
+// Функція для налаштування CDC читання - ВСІ потоки складеного пристрою
 void setup_cdc_reading(usb_device_handle_t dev_hdl) {
     // Отримуємо дескриптор конфігурації
     const usb_config_desc_t *config_desc;
     usb_host_get_active_config_descriptor(dev_hdl, &config_desc);
     
-    Serial.println("[CDC] Налаштовуємо CDC інтерфейс...");
+    Serial.println("[CDC] Налаштовуємо CDC інтерфейси...");
     
-    // Шукаємо CDC інтерфейси
-    const usb_intf_desc_t *data_intf_desc = NULL;
-    const usb_ep_desc_t *in_ep_desc = NULL;
-    int offset = 0;
-    int data_intf_num = -1;
+    UsbConfigLayout layout;
+    if (!layout.parse((const uint8_t *)config_desc, config_desc->wTotalLength)) {
+        Serial.println("[CDC] Пошкоджений дескриптор конфігурації!");
+        return;
+    }
+    if (layout.isTruncated()) {
+        Serial.printf("[CDC] Дескриптор більший за ліміти (%d інтерфейсів, %d endpoint'ів) - частину пропущено\n",
+                      USBDESC_MAX_INTERFACES, USBDESC_MAX_ENDPOINTS);
+    }
     
-    while (offset < config_desc->wTotalLength) {
-        const usb_standard_desc_t *desc = (const usb_standard_desc_t *)((uint8_t *)config_desc + offset);
-        
-        if (desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_INTERFACE) {
-            const usb_intf_desc_t *intf_desc = (const usb_intf_desc_t *)desc;
-            
-            Serial.printf("[CDC] Інтерфейс %d, клас: 0x%02X, підклас: 0x%02X\n", 
-                         intf_desc->bInterfaceNumber, 
-                         intf_desc->bInterfaceClass,
-                         intf_desc->bInterfaceSubClass);
-            
-            // CDC Data інтерфейс (клас 0x0A) або шукаємо будь-який з endpoints
-            if (intf_desc->bInterfaceClass == 0x0A || intf_desc->bNumEndpoints > 0) {
-                data_intf_desc = intf_desc;
-                data_intf_num = intf_desc->bInterfaceNumber;
-                Serial.printf("[CDC] Використовуємо інтерфейс %d як CDC Data\n", data_intf_num);
-            }
-        } else if (desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_ENDPOINT && data_intf_desc != NULL) {
-            const usb_ep_desc_t *ep_desc = (const usb_ep_desc_t *)desc;
-            
-            Serial.printf("[CDC] Endpoint: 0x%02X, тип: 0x%02X, напрямок: %s\n", 
-                         ep_desc->bEndpointAddress,
-                         ep_desc->bmAttributes & 0x03,
-                         (ep_desc->bEndpointAddress & 0x80) ? "IN" : "OUT");
-            
-            // Шукаємо Bulk IN endpoint
-            if ((ep_desc->bEndpointAddress & 0x80) == 0x80 && 
-                (ep_desc->bmAttributes & 0x03) == 0x02) { // Bulk transfer
-                in_ep_desc = ep_desc;
-                cdc_in_endpoint = ep_desc->bEndpointAddress; // Зберігаємо для задачі
-                Serial.printf("[CDC] Знайдено Bulk IN endpoint: 0x%02X\n", ep_desc->bEndpointAddress);
-                break;
-            }
-        }
-        
-        offset += desc->bLength;
+    for (int i = 0; i < layout.interfacesCount(); i++) {
+        const UsbInterfaceInfo &intf = layout.interfaceAt(i);
+        Serial.printf("[CDC] Інтерфейс %d, клас: 0x%02X, підклас: 0x%02X, функція: %d\n",
+                     intf.number, intf.cls, intf.subClass, intf.function);
     }
     
-        if (data_intf_num >= 0 && in_ep_desc != NULL) {
-        // Відкриваємо інтерфейс
-        esp_err_t err = usb_host_interface_claim(client_hdl, dev_hdl, data_intf_num, 0);
-        if (err != ESP_OK) {
-            Serial.printf("[CDC] Помилка відкриття інтерфейсу: %s\n", esp_err_to_name(err));
-            return;
+    // Спершу вибираємо потоки - теги мають бути готові до першого transfer'а
+    UsbStreamSelection selection = { USB_STREAM_CLASSES, USB_STREAM_INTERFACES };
+    int selected[LoggerPipelineConfig::usbMaxStreams];
+    int selectedCount = 0;
+    for (int i = 0; i < layout.endpointsCount(); i++) {
+        const UsbEndpointInfo &ep = layout.endpointAt(i);
+        Serial.printf("[CDC] Endpoint: 0x%02X, тип: 0x%02X, напрямок: %s, інтерфейс: %d\n",
+                     ep.address, ep.type, UsbConfigLayout::isIn(ep) ? "IN" : "OUT",
+                     layout.interfaceOf(ep).number);
+        if (!layout.matches(ep, selection)) continue;
+        if (selectedCount >= LoggerPipelineConfig::usbMaxStreams) {
+            Serial.printf("[CDC] Bulk IN 0x%02X пропущено - максимум %d потоків\n", ep.address, LoggerPipelineConfig::usbMaxStreams);
+            continue;
         }
-        Serial.printf("[CDC] Інтерфейс %d успішно відкрито\n", data_intf_num);
+        selected[selectedCount++] = i;
+    }
+    
+    usbStreamCount = 0;
+    uint32_t notifyInterfaces = 0;   // Інтерфейси керування CDC наших потоків
+    for (int n = 0; n < selectedCount; n++) {
+        const UsbEndpointInfo &ep = layout.endpointAt(selected[n]);
+        const UsbInterfaceInfo &intf = layout.interfaceOf(ep);
+        if (!claim_usb_interface(dev_hdl, intf.number)) continue;
         
-        // Створюємо ШВИДКИЙ асинхронний transfer для реального часу
-        usb_transfer_t *transfer;
-        err = usb_host_transfer_alloc(USB_BUFFER_SIZE, 0, &transfer);
-        if (err != ESP_OK) {
-            Serial.printf("[CDC] Помилка створення transfer: %s\n", esp_err_to_name(err));
-            return;
+        UsbStream &stream = usbStreams[usbStreamCount];
+        stream.endpoint = ep.address;
+        stream.interfaceNumber = intf.number;
+        stream.ended = false;
+        // Один потік - рядки без тегу, як і раніше
+        if (selectedCount > 1) {
+            snprintf(stream.tag, sizeof(stream.tag), "[if%d] ", intf.number);
+        } else {
+            stream.tag[0] = '\0';
         }
         
-        // АКТИВУЄМО основний transfer для максимальної швидкості
-        Serial.println("[CDC] Основний ШВИДКИЙ transfer АКТИВОВАНО");
-        
-        transfer->device_handle = dev_hdl;
-        transfer->bEndpointAddress = in_ep_desc->bEndpointAddress;
-        transfer->callback = usb_transfer_cb;
-        transfer->context = (void*)(uintptr_t)0; // Основний transfer
-        transfer->num_bytes = USB_BUFFER_SIZE;
-        transfer->timeout_ms = 10; // Швидкий timeout
-        
-        // Запускаємо transfer
-        err = usb_host_transfer_submit(transfer);
-        if (err == ESP_OK) {
-            Serial.printf("[CDC] Основний ШВИДКИЙ transfer запущено\n");
-        } else {
-            Serial.printf("[CDC] Помилка запуску основного transfer: %s\n", esp_err_to_name(err));
-            usb_host_transfer_free(transfer);
-            return;
+        int started = 0;
+        for (int t = 0; t < LoggerPipelineConfig::usbTransfersPerStream; t++) {
+            if (start_usb_transfer(dev_hdl, ep.address, USB_BUFFER_SIZE, usb_transfer_cb, &stream)) started++;
         }
+        if (started == 0) continue;
+        Serial.printf("[CDC] Потік %d: Bulk IN 0x%02X, інтерфейс %d, transfer'ів: %d\n",
+                     usbStreamCount, ep.address, intf.number, started);
+        usbStreamCount++;
         
-        Serial.println("[CDC] Система готова до читання в РЕАЛЬНОМУ ЧАСІ!");
+        int control = layout.controlInterfaceFor(ep);
+        if (control >= 0 && control < 32) notifyInterfaces |= 1UL << control;
+    }
+    
+    // Сповіщення CDC (DCD/DSR/break) - interrupt IN інтерфейсів керування наших потоків
+    int notifyCount = 0;
+    for (int i = 0; i < layout.endpointsCount(); i++) {
+        const UsbEndpointInfo &ep = layout.endpointAt(i);
+        uint8_t number = layout.interfaceOf(ep).number;
+        if (!layout.isNotification(ep) || number >= 32 || !(notifyInterfaces & (1UL << number))) continue;
+        if (!claim_usb_interface(dev_hdl, number)) continue;
         
-        // ВІДКЛЮЧАЄМО додаткову задачу - використовуємо тільки швидкий callback
-        // xTaskCreate(cdc_reader_task, "cdc_reader", 4096, NULL, 4, NULL);
+        // Розмір кратний max packet, щоб SERIAL_STATE (10 байт) прийшов одним transfer'ом
+        size_t size = ep.maxPacket > 0 ? ep.maxPacket : 8;
+        while (size < 16) size += size;
+        if (size > USB_NOTIFY_BUFFER_SIZE) size = USB_NOTIFY_BUFFER_SIZE;
+        if (start_usb_transfer(dev_hdl, ep.address, size, usb_notify_cb, NULL)) {
+            Serial.printf("[CDC] Сповіщення: Interrupt IN 0x%02X, інтерфейс %d\n", ep.address, number);
+            notifyCount++;
+        }
+    }
+    
+    if (usbStreamCount > 0) {
+        Serial.printf("[CDC] Потоків: %d, сповіщень: %d - система готова до читання в РЕАЛЬНОМУ ЧАСІ!\n",
+                     usbStreamCount, notifyCount);
     } else {
         Serial.println("[CDC] Не знайдено підходящий інтерфейс або endpoint!");
     }
 }
 
+// Закриває відключений пристрій, коли повернулись усі його transfer'и
+void close_usb_device_if_idle() {
+    if (!usbClosePending || usbTransfersInFlight > 0) return;
+    
+    for (int i = 0; i < usbTransferTotal; i++) {
+        usb_host_transfer_free(usbTransfers[i]);
+    }
+    usbTransferTotal = 0;
+    if (device_handle != NULL) {
+        for (int i = 0; i < claimedInterfaceCount; i++) {
+            usb_host_interface_release(client_hdl, device_handle, claimedInterfaces[i]);
+        }
+        usb_host_device_close(client_hdl, device_handle);
+        device_handle = NULL;
+    }
+    claimedInterfaceCount = 0;
+    usbClosePending = false;
+}
+
+// Відкриває пристрій за адресою і налаштовує всі його потоки
+void open_usb_device(uint8_t address) {
+    esp_err_t err = usb_host_device_open(client_hdl, address, &device_handle);
+    if (err == ESP_OK && device_handle != NULL) {
+        Serial.printf("[USB] Отримано handle пристрою (addr: %d)\n", address);
+        setup_cdc_reading(device_handle);
+    } else {
+        Serial.printf("[USB] Помилка відкриття пристрою: %s\n", esp_err_to_name(err));
+    }
+}
+
+uint8_t pendingDeviceAddr = 0;   // Новий пристрій чекає, поки закриється попередній
+
 // USB Host подія callback
 void client_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg) {
     switch (event_msg->event) {
@@ -597,13 +1168,12 @@ void client_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg) {
             usb_host_device_addr_list_fill(10, dev_addr_list, &num_dev);
             
             if (num_dev > 0) {
-                // Отримуємо handle для першого пристрою
-                esp_err_t err = usb_host_device_open(client_hdl, dev_addr_list[0], &device_handle);
-                if (err == ESP_OK && device_handle != NULL) {
-                    Serial.printf("[USB] Отримано handle пристрою (addr: %d)\n", dev_addr_list[0]);
-                    setup_cdc_reading(device_handle);
+                // Попередній пристрій ще повертає transfer'и - відкриємо, коли закриється
+                close_usb_device_if_idle();
+                if (usbClosePending) {
+                    pendingDeviceAddr = dev_addr_list[0];
                 } else {
-                    Serial.printf("[USB] Помилка відкриття пристрою: %s\n", esp_err_to_name(err));
+                    open_usb_device(dev_addr_list[0]);
                 }
             }
             break;
@@ -611,10 +1181,15 @@ void client_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg) {
         case USB_HOST_CLIENT_EVENT_DEV_GONE: {
             Serial.println("[USB] Пристрій відключено!");
             device_connected = false;
-            if (device_handle != NULL) {
-                usb_host_device_close(client_hdl, device_handle);
-                device_handle = NULL;
+            for (int i = 0; i < usbStreamCount; i++) {
+                usbStreams[i].ended = true;
+            }
+            if (processorTaskHandle != NULL) {
+                xTaskNotifyGive(processorTaskHandle);
             }
+            // Transfer'и повертаються зі статусом NO_DEVICE - закриваємо, коли повернуться всі
+            usbClosePending = true;
+            close_usb_device_if_idle();
             break;
         }
         default:
@@ -670,10 +1245,47 @@ void usb_host_task(void *arg) {
         // Обробка подій клієнта з мінімальним timeout
         usb_host_client_handle_events(client_hdl, 5); // 5мс замість 0
         
+        // Відкладене закриття відключеного пристрою і відкриття нового
+        close_usb_device_if_idle();
+        if (pendingDeviceAddr != 0 && !usbClosePending) {
+            open_usb_device(pendingDeviceAddr);
+            pendingDeviceAddr = 0;
+        }
+        
         vTaskDelay(pdMS_TO_TICKS(1)); // Мінімальна затримка 1мс
     }
 }
 
+#ifdef LOGGER_TRACE
+// Вивантаження трасування: "[TRACE] BEGIN <байт>", сирі байти, "[TRACE] END".
+// Все одним Serial.write - блоки Serial sink'а не вклиняться посеред бінарних даних
+void dumpTrace() {
+    const size_t headerRoom = 32;
+    const char footer[] = "\n[TRACE] END\n";
+    size_t cap = headerRoom + Tracer::maxSerializedSize() + sizeof(footer);
+    uint8_t *buf = (uint8_t *)loggerAlloc(cap);
+    if (buf == NULL) {
+        Serial.println("[TRACE] Недостатньо пам'яті для вивантаження");
+        return;
+    }
+    
+    // Запис, що вже почався на іншому ядрі, встигає завершитись
+    bool wasEnabled = tracer.isEnabled();
+    tracer.setEnabled(false);
+    delay(1);
+    size_t len = tracer.serialize(buf + headerRoom, Tracer::maxSerializedSize());
+    tracer.setEnabled(wasEnabled);
+    
+    char header[headerRoom];
+    int headerLen = snprintf(header, sizeof(header), "[TRACE] BEGIN %u\n", (unsigned)len);
+    uint8_t *start = buf + headerRoom - headerLen;
+    memcpy(start, header, headerLen);
+    memcpy(buf + headerRoom + len, footer, sizeof(footer) - 1);
+    Serial.write(start, headerLen + len + sizeof(footer) - 1);
+    loggerFree(buf);
+}
+#endif
+
 void setup() {
     Serial.begin(115200);
     
@@ -695,15 +1307,16 @@ void setup() {
         rtc_working = true;
         DateTime now = rtc.now();
         
-        // ІНІЦІАЛІЗУЄМО швидкий лічільник часу
-        fastTime.year = now.year();
-        fastTime.month = now.month();
-        fastTime.day = now.day();
-        fastTime.hour = now.hour();
-        fastTime.minute = now.minute();
-        fastTime.second = now.second();
-        fastTime.lastMillis = millis();
-        fastTime.lastSyncMillis = millis();
+        // ІНІЦІАЛІЗУЄМО швидкий лічільник часу - на межі секунди DS1307, щоб фаза
+        // збігалась з RTC (до 1 с очікування; RTC стоїть - беремо як є)
+        uint32_t waitStart = millis();
+        DateTime next = rtc.now();
+        while (next.second() == now.second() && millis() - waitStart < 1100) {
+            delay(1);
+            next = rtc.now();
+        }
+        now = next;
+        setFastTime(now, millis());
         
         Serial.printf("Час з RTC: %04d-%02d-%02d %02d:%02d:%02d\n",
                       now.year(), now.month(), now.day(),
@@ -714,14 +1327,7 @@ void setup() {
         rtc_working = false;
         
         // Ініціалізуємо з базовими значеннями
-        fastTime.year = 2025;
-        fastTime.month = 9;
-        fastTime.day = 28;
-        fastTime.hour = 12;
-        fastTime.minute = 0;
-        fastTime.second = 0;
-        fastTime.lastMillis = millis();
-        fastTime.lastSyncMillis = millis();
+        setFastTime(DateTime(2025, 9, 28, 12, 0, 0), millis());
     }
     
     // Тест SD карти
@@ -794,6 +1400,38 @@ void setup() {
         sd_available = false;
     }
     
+    // Етапи конвеєра, яких немає в LoggerPipelineConfig, пропускаються.
+    // Проріджування і повтори - у кожного потоку свої, налаштування однакові
+    for (int s = 0; s < ingest.streams(); s++) {
+        if (LineDedup *dedup = ingest.dedup(s)) {
+            dedup->configure(DEDUP_ENABLED_DEFAULT, DEDUP_FUZZY_DEFAULT, DEDUP_MAX_HOLD_MS);
+        }
+        if (LineDecimator *decimator = ingest.decimator(s)) {
+            for (size_t i = 0; i < sizeof(DECIMATION_RULES) / sizeof(DECIMATION_RULES[0]); i++) {
+                if (!decimator->addRule(DECIMATION_RULES[i]) && s == 0) {
+                    Serial.printf("[DECIM] Правило '%s' не додано\n", DECIMATION_RULES[i].prefix);
+                }
+            }
+            decimator->setPassthrough(DECIMATION_PASSTHROUGH_DEFAULT);
+        }
+    }
+    
+    if (TelemetryStore *telemetry = ingest.telemetry()) {
+        for (size_t i = 0; i < sizeof(TELEMETRY_SCHEMAS) / sizeof(TELEMETRY_SCHEMAS[0]); i++) {
+            telemetry->addSchema(TELEMETRY_SCHEMAS[i]);
+        }
+        telemetry->setOutput(writeTelemetryBlock, NULL);
+        telemetry->setEnabled(TELEMETRY_ENABLED_DEFAULT && sd_available);
+        if (sd_available && currentLogFile.length() > 0) {
+            startTelemetryFile(currentLogFile);
+        }
+    }
+    
+    // Пул спільних блоків рядків (у PSRAM)
+    if (!linePool.begin(LoggerPipelineConfig::blockCount, LoggerPipelineConfig::blockBytes)) {
+        Serial.println("[SINK] Не вдалося виділити пам'ять для блоків рядків!");
+    }
+    
     Serial.println("Ініціалізація USB Host...");
     
     // Налаштовуємо GPIO для USB-OTG (Host mode)
@@ -804,11 +1442,41 @@ void setup() {
     xTaskCreate(usb_host_task, "usb_host", 6144, NULL, 5, NULL);
     
     // Створюємо ОКРЕМИЙ потік для обробки буфера (БІЛЬШИЙ стек для безпеки)
-    xTaskCreate(buffer_processor_task, "buffer_proc", 8192, NULL, 4, NULL);
+    batchController.configure(LoggerPipelineConfig::batch);
+    for (int i = 0; i < LoggerPipelineConfig::usbMaxStreams; i++) {
+        usbStreams[i].framer.setMaxLineLength(LINE_SEGMENT_DEFAULT);
+        usbStreams[i].framer.setIdleFlushMs(LINE_IDLE_FLUSH_DEFAULT);
+    }
+    xTaskCreate(buffer_processor_task, "buffer_proc", 8192, NULL, 4, &processorTaskHandle);
     
-    // Створюємо АСИНХРОННИЙ SD потік (найнижчий пріоритет)
+    // Sink'и з ВЛАСНИМИ чергами: Serial показує свіжі дані, SD при переповненні губить нові блоки
+    // (метрики sinks), але НІКОЛИ не зупиняє обробник - інакше повільна карта гальмує і Serial
+    serialSinkIndex = start_sink(sinkFanout, &serialSink,
+                                 LoggerPipelineConfig::serialQueueDepth, OverflowPolicy::DROP_OLDEST, 0, 5, 3);
+    
+    // АСИНХРОННИЙ SD потік (найнижчий пріоритет)
     if (sd_available) {
-        xTaskCreate(sd_writer_task, "sd_writer", 4096, NULL, 2, NULL);
+        sdSinkIndex = start_sink(sinkFanout, &sdSink,
+                                 LoggerPipelineConfig::sdQueueDepth, OverflowPolicy::DROP_NEWEST, 0, 100, 2);
+        updateSdSinks();
+        
+        // Самописець - теж sink, отримує ті самі блоки
+        if (flightRecorder.begin(LoggerPipelineConfig::recorderBytes, &recorderOutput)) {
+            FlightRecorderConfig frConfig = { FR_POST_TRIGGER_MS, FR_RATE_SPIKE_FACTOR, FR_RATE_MIN_BPS, FR_STALL_MS };
+            flightRecorder.configure(frConfig);
+            for (size_t i = 0; i < sizeof(FR_DEFAULT_PATTERNS) / sizeof(FR_DEFAULT_PATTERNS[0]); i++) {
+                flightRecorder.addPattern(FR_DEFAULT_PATTERNS[i]);
+            }
+            // Sink тільки копіює блоки в кільце PSRAM, вікно на SD пише окремий потік
+            recorderSinkIndex = start_sink(sinkFanout, &flightRecorder,
+                                           LoggerPipelineConfig::recorderQueueDepth, OverflowPolicy::DROP_NEWEST, 0, 20, 2);
+            xTaskCreate(recorder_dump_task, "recorder_dump", 4096, NULL, 1, NULL);
+            setCaptureMode(CAPTURE_MODE_DEFAULT);
+        } else {
+            Serial.println("[CAPTURE] Недостатньо PSRAM для самописця");
+        }
+        start_sink(telemetryFanout, &telemetrySink,
+                   LoggerPipelineConfig::telemetryQueueDepth, OverflowPolicy::DROP_NEWEST, 0, 100, 2);
     }
     
     // Чекаємо ініціалізації
@@ -838,14 +1506,26 @@ void setup() {
 void loop() {
     // Тепер loop() тільки для команд Serial - USB обробляється окремим потоком!
     
+    // Заплановане встановлення часу - на межі секунди
+    servicePendingTimeSet();
+    
     // Обробка команд через Serial
-    if (Serial.available() > 0) {
-        String command = Serial.readString();
-        command.trim();
+    String command;
+    if (readCommandLine(command)) {
         
-        if (command.startsWith("settime")) {
+        if (command.startsWith("sync")) {
+            // NTP-подібна проба: t2 - прихід команди, t3 - відповідь (мкс esp_timer),
+            // wall - час RTC у мкс на момент t3. Токен хоста повертаємо як є
+            String token = command.substring(4);
+            token.trim();
+            int64_t t3 = esp_timer_get_time();
+            Serial.printf("[SYNC] %s %lld %lld %lld\n", token.c_str(),
+                          (long long)commandRxUs, (long long)t3, (long long)getWallTimeUs(t3));
+        } else if (command.startsWith("settime")) {
             if (rtc_working) {
-                // Формат команди: settime YYYY-MM-DD HH:MM:SS
+                // Формат: settime YYYY-MM-DD HH:MM:SS[.mmm] [@US]
+                //   .mmm - мілісекунди на момент відправки, час ставиться на наступній межі секунди
+                //   @US  - esp_timer мкс логера, в які настає вказана секунда (sync-інструмент)
                 if (command.length() >= 27) { // "settime " + 19 символів дати/часу
                     String dateTimeStr = command.substring(8); // Пропускаємо "settime "
                     
@@ -856,25 +1536,31 @@ void loop() {
                     int hour = dateTimeStr.substring(11, 13).toInt();
                     int minute = dateTimeStr.substring(14, 16).toInt();
                     int second = dateTimeStr.substring(17, 19).toInt();
+                    uint32_t unixtime = DateTime(year, month, day, hour, minute, second).unixtime();
                     
-                    // Встановлюємо час в RTC і швидкому лічільнику
-                    DateTime newTime(year, month, day, hour, minute, second);
-                    rtc.adjust(newTime);
-                    
-                    // Оновлюємо швидкий лічільник
-                    fastTime.year = year;
-                    fastTime.month = month;
-                    fastTime.day = day;
-                    fastTime.hour = hour;
-                    fastTime.minute = minute;
-                    fastTime.second = second;
-                    fastTime.lastMillis = millis();
-                    fastTime.lastSyncMillis = millis();
+                    int64_t atUs = commandRxUs;
+                    int atPos = dateTimeStr.indexOf('@');
+                    if (atPos >= 0) {
+                        atUs = strtoll(dateTimeStr.c_str() + atPos + 1, NULL, 10);
+                    } else if (dateTimeStr.length() >= 23 && dateTimeStr[19] == '.') {
+                        // Вирівнювання фази: чекаємо решту секунди і ставимо наступну
+                        int ms = dateTimeStr.substring(20, 23).toInt();
+                        if (ms > 0) {
+                            atUs = commandRxUs + (int64_t)(1000 - ms) * 1000;
+                            unixtime += 1;
+                        }
+                    }
                     
-                    Serial.printf("[RTC] Час встановлено: %04d-%02d-%02d %02d:%02d:%02d\n",
-                                  year, month, day, hour, minute, second);
+                    if (atUs - esp_timer_get_time() > TIME_SET_MAX_AHEAD_US) {
+                        Serial.println("[RTC] Момент встановлення занадто далеко в майбутньому");
+                    } else {
+                        pendingTimeSet.unixtime = unixtime;
+                        pendingTimeSet.atUs = atUs;
+                        pendingTimeSet.active = true;
+                        servicePendingTimeSet();
+                    }
                 } else {
-                    Serial.println("[RTC] Помилковий формат. Використовуйте: settime YYYY-MM-DD HH:MM:SS");
+                    Serial.println("[RTC] Помилковий формат. Використовуйте: settime YYYY-MM-DD HH:MM:SS[.mmm] [@US]");
                 }
             } else {
                 Serial.println("[RTC] RTC модуль недоступний");
@@ -894,18 +1580,32 @@ void loop() {
                     logFile.println(timeStr + " === Новий сеанс логування ===");
                     logFile.close();
                     Serial.println("Файл успішно створено!");
+                    // Блоки телеметрії самодостатні - неповні просто допишуться в новий .tlm
+                    startTelemetryFile(currentLogFile);
                 } else {
                     Serial.println("Помилка створення нового файлу!");
                     currentLogFile = "";
                 }
+                updateSdSinks();
             } else {
                 Serial.println("[SD] SD карта недоступна");
             }
         } else if (command == "help") {
             Serial.println("=== Команди системи ===");
             Serial.println("gettime                    - показати поточний час");
-            Serial.println("settime YYYY-MM-DD HH:MM:SS - встановити час");
+            Serial.println("settime YYYY-MM-DD HH:MM:SS[.mmm] [@US] - встановити час (на межі секунди)");
+            Serial.println("sync TOKEN                 - проба синхронізації часу (set_rtc_time.py)");
             Serial.println("newlog                     - створити новий файл логів");
+            Serial.println("sinks                      - стан черг і лічильники sink'ів");
+            Serial.println("dedup on|fuzzy|off         - згортання повторюваних рядків");
+            Serial.println("telemetry on|off           - витяг числової телеметрії в .tlm");
+            Serial.println("decim on|off               - проріджування за префіксом (off - повна швидкість)");
+            Serial.println("capture on|off             - самописець: на SD тільки вікна навколо тригерів");
+            Serial.println("trigger                    - ручний тригер самописця");
+            Serial.println("frpattern TEXT|clear       - додати/очистити шаблони тригера");
+            Serial.println("maxline N                  - довжина сегмента довгих рядків, байт");
+            Serial.println("idleflush N                - віддати незавершений рядок після N мс тиші (0 - ні)");
+            Serial.println("trace [on|off|clear]       - вивантажити/керувати трасуванням (trace_export.py)");
             Serial.println("help                       - показати цю довідку");
             if (sd_available && currentLogFile.length() > 0) {
                 Serial.printf("Поточний файл логів: %s\n", currentLogFile.c_str());
@@ -913,13 +1613,184 @@ void loop() {
                 Serial.println("SD карта недоступна - логування тільки в Serial");
             }
         } else if (command == "status") {
-            Serial.printf("[STATUS] Буфер: %d/%d байт\n", lineBuffer.length(), LINE_BUFFER_SIZE);
-            Serial.printf("[STATUS] USB пристрій: %s\n", device_connected ? "підключено" : "відключено");
+            Serial.printf("[STATUS] USB пристрій: %s, потоків: %d\n",
+                          device_connected ? "підключено" : "відключено", usbStreamCount);
+            for (int i = 0; i < usbStreamCount; i++) {
+                UsbStream &stream = usbStreams[i];
+                Serial.printf("[STATUS] Потік %d (EP 0x%02X, інтерфейс %d): буфер %d/%d байт, втрачено: %d байт\n",
+                              i, stream.endpoint, stream.interfaceNumber,
+                              stream.ring.size(), stream.ring.capacity(), stream.ring.droppedBytes());
+            }
             Serial.printf("[STATUS] SD карта: %s\n", sd_available ? "доступна" : "недоступна");
             Serial.printf("[STATUS] RTC: %s\n", rtc_working ? "працює" : "недоступний");
+        } else if (command.startsWith("dedup")) {
+            String mode = command.substring(5);
+            mode.trim();
+            LineDedup *dedup = ingest.dedup(0);
+            if (dedup == NULL) {
+                Serial.println("[DEDUP] Етап не зібрано (LoggerPipelineConfig::dedup)");
+            } else {
+                // Режим перемикає обробник між пачками - після підсумку відкритої серії кожного потоку
+                bool on = dedup->isEnabled();
+                bool fuzzy = dedup->isFuzzy();
+                if (mode == "on" || mode == "fuzzy" || mode == "off") {
+                    on = mode != "off";
+                    fuzzy = mode == "fuzzy";
+                    for (int s = 0; s < ingest.streams(); s++) ingest.dedup(s)->requestMode(on, fuzzy);
+                }
+                DedupStats d = dedupStatsTotal();
+                Serial.printf("[DEDUP] %s%s, рядків: %d, придушено: %d, підсумків: %d\n",
+                              on ? "увімкнено" : "вимкнено",
+                              fuzzy ? " (fuzzy)" : "",
+                              d.linesIn, d.linesSuppressed, d.summaries);
+                Serial.printf("[DEDUP] Зекономлено: %d байт\n", (int32_t)d.bytesSuppressed - (int32_t)d.summaryBytes);
+            }
+        } else if (command.startsWith("decim")) {
+            String mode = command.substring(5);
+            mode.trim();
+            LineDecimator *decimator = ingest.decimator(0);
+            if (decimator == NULL) {
+                Serial.println("[DECIM] Етап не зібрано (LoggerPipelineConfig::decimation)");
+            } else {
+                // Незакриті вікна агрегації після "off" віддасть обробник буфера
+                if (mode == "on" || mode == "off") {
+                    for (int s = 0; s < ingest.streams(); s++) ingest.decimator(s)->setPassthrough(mode == "off");
+                }
+                DecimationStats d = decimationStatsTotal();
+                Serial.printf("[DECIM] %s, правил: %d, рядків: %d, пропущено: %d, агрегатів: %d\n",
+                              decimator->isPassthrough() ? "вимкнено (повна швидкість)" : "увімкнено",
+                              decimator->count(), d.linesIn, d.linesPassed, d.aggregates);
+                static const char *modeNames[] = { "every-n", "interval", "aggregate" };
+                for (int i = 0; i < decimator->count(); i++) {
+                    Serial.printf("[DECIM]   '%s' %s %d\n", decimator->rulePrefix(i),
+                                  modeNames[(int)decimator->ruleMode(i)], decimator->ruleParam(i));
+                }
+            }
+        } else if (command.startsWith("telemetry")) {
+            String mode = command.substring(9);
+            mode.trim();
+            TelemetryStore *telemetry = ingest.telemetry();
+            if (telemetry == NULL) {
+                Serial.println("[TLM] Етап не зібрано (LoggerPipelineConfig::telemetry)");
+            } else {
+                if (mode == "on") {
+                    if (currentTelemetryFile.length() > 0) {
+                        telemetry->setEnabled(true);
+                    } else {
+                        Serial.println("[TLM] Немає файлу телеметрії (SD недоступна?)");
+                    }
+                } else if (mode == "off") {
+                    // Хвости колонок скидає обробник у наступному ingest.poll()
+                    telemetry->setEnabled(false);
+                    telemetry->requestFlush();
+                }
+                const TelemetryStats &t = telemetry->stats();
+                Serial.printf("[TLM] %s, схем: %d, файл: %s\n",
+                              telemetry->isEnabled() ? "увімкнено" : "вимкнено",
+                              telemetry->count(), currentTelemetryFile.c_str());
+                Serial.printf("[TLM] Рядків: %d розпізнано, %d ні; блоків: %d (втрачено %d)\n",
+                              t.linesMatched, t.linesUnmatched, t.blocksWritten, telemetryBlocksLost);
+                Serial.printf("[TLM] Текст: %d байт -> колонки: %d байт (%.1fx), кодування: %d мкс\n",
+                              t.textBytes, t.encodedBytes,
+                              t.encodedBytes > 0 ? (float)t.textBytes / t.encodedBytes : 0.0f,
+                              t.encodeTimeUs);
+            }
+        } else if (command.startsWith("capture")) {
+            String mode = command.substring(7);
+            mode.trim();
+            if (recorderSinkIndex < 0) {
+                Serial.println("[CAPTURE] Самописець недоступний (немає SD або PSRAM)");
+            } else {
+                if (mode == "on") setCaptureMode(true);
+                else if (mode == "off") setCaptureMode(false);
+                
+                const FlightRecorderStats &fr = flightRecorder.stats();
+                Serial.printf("[CAPTURE] %s%s, у кільці: %d/%d байт\n",
+                              captureMode ? "увімкнено" : "вимкнено",
+                              flightRecorder.isCapturing() ? " (йде запис вікна)" : "",
+                              flightRecorder.buffered(), flightRecorder.capacity());
+                Serial.printf("[CAPTURE] Тригерів: %d, вікон: %d, вивантажено: %d байт, втрачено: %d байт\n",
+                              fr.triggers, fr.captures, fr.bytesDumped, fr.bytesLost);
+                Serial.printf("[CAPTURE] Записано в кільце: %d байт (на SD пішло %.2f%%)\n", fr.bytesRecorded,
+                              fr.bytesRecorded > 0 ? 100.0f * fr.bytesDumped / fr.bytesRecorded : 0.0f);
+            }
+        } else if (command == "trigger") {
+            if (captureMode) {
+                flightRecorder.trigger();
+                Serial.println("[CAPTURE] Ручний тригер");
+            } else {
+                Serial.println("[CAPTURE] Режим самописця вимкнено (capture on)");
+            }
+        } else if (command.startsWith("frpattern")) {
+            String pattern = command.substring(9);
+            pattern.trim();
+            // Шаблони читає потік самописця - міняємо тільки поза режимом запису
+            if (captureMode) {
+                Serial.println("[CAPTURE] Спочатку вимкніть самописець (capture off)");
+            } else if (pattern == "clear") {
+                flightRecorder.clearPatterns();
+            } else if (pattern.length() > 0 && !flightRecorder.addPattern(pattern.c_str())) {
+                Serial.printf("[CAPTURE] Не вдалося додати шаблон (макс. %d по %d символів)\n",
+                              FR_MAX_PATTERNS, FR_MAX_PATTERN_LEN - 1);
+            }
+            for (int i = 0; i < flightRecorder.patternsCount(); i++) {
+                Serial.printf("[CAPTURE] Шаблон %d: %s\n", i + 1, flightRecorder.pattern(i));
+            }
+        } else if (command.startsWith("maxline")) {
+            // Ліміт змінює обробник перед наступним рядком - не посеред копіювання
+            long value = command.substring(7).toInt();
+            size_t maxLine = usbStreams[0].framer.maxLineLength();
+            for (int i = 0; value > 0 && i < LoggerPipelineConfig::usbMaxStreams; i++) {
+                maxLine = usbStreams[i].framer.requestMaxLineLength(value);
+            }
+            Serial.printf("[LINE] Сегмент довгих рядків: %d байт (макс. %d)\n",
+                          (int)maxLine, (int)LoggerPipelineConfig::lineMaxLength);
+        } else if (command.startsWith("idleflush")) {
+            String value = command.substring(9);
+            value.trim();
+            for (int i = 0; value.length() > 0 && i < LoggerPipelineConfig::usbMaxStreams; i++) {
+                usbStreams[i].framer.setIdleFlushMs(value.toInt());
+            }
+            Serial.printf("[LINE] Idle flush: %d мс%s\n", usbStreams[0].framer.idleFlush(),
+                          usbStreams[0].framer.idleFlush() == 0 ? " (вимкнено)" : "");
+        } else if (command.startsWith("trace")) {
+#ifdef LOGGER_TRACE
+            String mode = command.substring(5);
+            mode.trim();
+            if (mode == "on") {
+                tracer.setEnabled(true);
+            } else if (mode == "off") {
+                tracer.setEnabled(false);
+            } else if (mode == "clear") {
+                bool wasEnabled = tracer.isEnabled();
+                tracer.setEnabled(false);
+                delay(1);
+                tracer.clear();
+                tracer.setEnabled(wasEnabled);
+            } else if (mode.length() == 0) {
+                dumpTrace();
+            }
+            Serial.printf("[TRACE] %s, подій записано: %u (кільце %d подій x %d ядер)\n",
+                          tracer.isEnabled() ? "увімкнено" : "вимкнено", (unsigned)tracer.written(),
+                          TRACE_RING_EVENTS, LOGGER_CORES);
+#else
+            Serial.println("[TRACE] Трасування не зібрано (build_flags = -DLOGGER_TRACE)");
+#endif
+        } else if (command == "sinks") {
+            Serial.printf("[SINKS] Вільних блоків: %d/%d по %d байт, пул вичерпувався: %d разів\n",
+                          linePool.available(), linePool.size(), linePool.blockBytes(), linePool.exhausted());
+            for (int i = 0; i < sinkFanout.count(); i++) {
+                SinkMetrics m = sinkFanout.metrics(i);
+                Serial.printf("[SINKS] %s: %s, черга %d/%d (макс. %d), %s\n",
+                              sinkFanout.sink(i)->name(), sinkFanout.enabled(i) ? "увімкнено" : "вимкнено",
+                              sinkFanout.queued(i), sinkFanout.depth(i), m.maxDepth,
+                              overflowPolicyName(sinkFanout.policy(i)));
+                Serial.printf("[SINKS]   записано %d рядків/%d байт, втрачено %d рядків, очікування %d мкс\n",
+                              m.linesWritten, m.bytesWritten, m.linesDropped, m.blockedUs);
+            }
         }
     }
     
-    // Невелика затримка для loop()
-    delay(10);
+    // Коротка пауза - sync-проби і заплановане встановлення часу чекають не довше 1мс
+    delay(1);
 }
\ No newline at end of file
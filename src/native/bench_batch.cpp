@@ -0,0 +1,218 @@
+/*
+ * Режим batch: затримка і пропускна здатність обробника під сплесками.
+ *
+ * Продюсер-потік імітує USB callback: порції по NATIVE_CHUNK байт у кільце
+ * і сповіщення обробнику (як xTaskNotifyGive). Навантаження - сплески
+ * BATCH_BURST_MS на BATCH_BURST_BPS, між ними тиша. Кожен рядок несе
+ * мітку часу запису в кільце, тому затримка = від запису до обробки.
+ * Порція, що не влізла в кільце, відкидається цілком і рахується втраченою.
+ *
+ * Порівнюються два обробники на одному конвеєрі:
+ *   fixed    - як до BatchController: до 10 рядків за цикл, 1 мс паузи
+ *              кожні 5 рядків, потім 10 мс сну;
+ *   adaptive - BatchController з параметрами прошивки, очікування
+ *              сповіщення без даних.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "native.h"
+#include "batch_controller.h"
+
+#define BATCH_RUN_MS 3000
+#define BATCH_BURST_MS 50
+#define BATCH_PERIOD_MS 500
+#define BATCH_BURST_BPS 800000          // ~USB FS CDC на повній швидкості
+#define BATCH_LINE_BYTES 64
+#define BATCH_STAMP_DIGITS 10
+
+struct BenchBatchConfig : DefaultIngestConfig {
+    static constexpr bool decimation = false;
+    static constexpr bool telemetry = false;
+    static constexpr bool dedup = false;
+};
+
+// Сповіщення обробника - як xTaskNotifyGive/ulTaskNotifyTake
+class Notifier {
+public:
+    Notifier() : pending(false) {}
+    void give() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = true;
+        }
+        cv.notify_one();
+    }
+    void take(uint32_t timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return pending; });
+        pending = false;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool pending;
+};
+
+struct BatchResult {
+    uint64_t linesIn;
+    uint64_t linesOut;
+    uint64_t bytesLost;
+    uint32_t cycles;
+    uint32_t maxCycleUs;
+    std::vector<uint32_t> latencyUs;
+};
+
+// Лічильники потоку продюсера - окремо від BatchResult, який пише обробник;
+// зводяться в результат після join()
+struct ProducerCounts {
+    uint64_t linesIn;
+    uint64_t bytesLost;
+};
+
+static void produce(ByteRing &ring, Notifier &notify, std::atomic<bool> &running, ProducerCounts &in) {
+    const uint32_t chunkUs = (uint32_t)((uint64_t)NATIVE_CHUNK * 1000000 / BATCH_BURST_BPS);
+    uint8_t chunk[NATIVE_CHUNK];
+    uint32_t t0 = loggerMillis();
+    while (loggerMillis() - t0 < BATCH_RUN_MS) {
+        uint32_t phase = (loggerMillis() - t0) % BATCH_PERIOD_MS;
+        if (phase >= BATCH_BURST_MS) {
+            loggerSleepMs(BATCH_PERIOD_MS - phase);
+            continue;
+        }
+        uint32_t stamp = loggerMicros();
+        size_t n = 0;
+        while (n + BATCH_LINE_BYTES <= sizeof(chunk)) {
+            char *line = (char *)chunk + n;
+            snprintf(line, BATCH_STAMP_DIGITS + 1, "%010u", (unsigned)stamp);
+            memset(line + BATCH_STAMP_DIGITS, 'd', BATCH_LINE_BYTES - BATCH_STAMP_DIGITS - 1);
+            line[BATCH_LINE_BYTES - 1] = '\n';
+            n += BATCH_LINE_BYTES;
+        }
+        in.linesIn += n / BATCH_LINE_BYTES;
+        if (ring.capacity() - ring.size() < n) {
+            in.bytesLost += n;
+        } else {
+            ring.write(chunk, n);
+        }
+        notify.give();
+        std::this_thread::sleep_for(std::chrono::microseconds(chunkUs));
+    }
+    running.store(false);
+    notify.give();
+}
+
+static BatchResult runBatch(bool adaptive) {
+    static uint8_t ringStorage[BenchBatchConfig::ringBytes];
+    static char framerStorage[LINE_FRAMER_BUFFER_SIZE(BenchBatchConfig::lineMaxLength)];
+    LineBlockPool pool;
+    pool.begin(BenchBatchConfig::blockCount, BenchBatchConfig::blockBytes);
+    SinkFanout fanout;
+    HashSink sink;
+    fanout.add(&sink, MAX_SINK_QUEUE_DEPTH, OverflowPolicy::DROP_NEWEST);
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    FixedClock clock;
+    IngestPipeline<BenchBatchConfig, FixedClock> pipeline(clock, pool, fanout);
+    BatchController controller;
+    BatchConfig config = { 4, 512, 5000, 1, 100, 50 };   // BATCH_* прошивки
+    controller.configure(config);
+
+    BatchResult r;
+    r.linesIn = r.linesOut = r.bytesLost = 0;
+    r.cycles = r.maxCycleUs = 0;
+    Notifier notify;
+    std::atomic<bool> running(true);
+    ProducerCounts in = { 0, 0 };
+    std::thread producer(produce, std::ref(ring), std::ref(notify), std::ref(running), std::ref(in));
+
+    // Як drain(), але з заміром затримки кожного рядка
+    auto emit = [&](const char *line, size_t len) {
+        if (len >= BATCH_STAMP_DIGITS) {
+            r.latencyUs.push_back(loggerMicros() - (uint32_t)strtoul(std::string(line, BATCH_STAMP_DIGITS).c_str(), NULL, 10));
+        }
+        r.linesOut++;
+        pipeline.line(0, line, len);
+    };
+
+    while (running.load() || ring.size() > 0) {
+        uint32_t cycleStart = loggerMicros();
+        uint32_t lines = 0;
+        bool drained = false;
+        if (adaptive) {
+            size_t fill = ring.size();
+            uint32_t limit = controller.beginCycle(fill);
+            pipeline.beginBatch(fill, limit);
+            while (lines < limit && controller.withinBudget(cycleStart)) {
+                if (!framer.next(ring, emit)) {
+                    drained = true;
+                    break;
+                }
+                lines++;
+            }
+        } else {
+            for (; lines < 10; lines++) {
+                pipeline.beginBatch(0, 0);
+                if (!framer.next(ring, emit)) break;
+                if (lines % 5 == 4) loggerSleepMs(1);
+            }
+        }
+        pipeline.poll(loggerMillis());
+        fanout.service(0);
+
+        uint32_t cycleUs = loggerMicros() - cycleStart;
+        r.cycles++;
+        if (adaptive) {
+            uint32_t waitMs = controller.endCycle(lines, lines * BATCH_LINE_BYTES, cycleUs, drained,
+                                                  ring.size(), ring.capacity());
+            if (cycleUs > r.maxCycleUs) r.maxCycleUs = cycleUs;
+            if (waitMs <= config.busyWaitMs) {
+                loggerSleepMs(config.busyWaitMs);
+            } else {
+                notify.take(pipeline.writer().maxWaitMs(loggerMillis(), waitMs));
+            }
+        } else {
+            if (cycleUs > r.maxCycleUs) r.maxCycleUs = cycleUs;
+            loggerSleepMs(10);
+        }
+    }
+    producer.join();
+    r.linesIn = in.linesIn;
+    r.bytesLost = in.bytesLost;
+    pipeline.writer().publish();
+    fanout.service(0);
+    pool.end();
+    return r;
+}
+
+static uint32_t percentile(std::vector<uint32_t> &v, double p) {
+    if (v.empty()) return 0;
+    size_t i = (size_t)(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+int benchBatch() {
+    printf("Сплески %d мс на %d KB/s кожні %d мс, %d мс; рядок %d байт, кільце %d байт\n",
+           BATCH_BURST_MS, BATCH_BURST_BPS / 1000, BATCH_PERIOD_MS, BATCH_RUN_MS, BATCH_LINE_BYTES,
+           (int)BenchBatchConfig::ringBytes);
+    const char *names[] = { "fixed", "adaptive" };
+    for (int adaptive = 0; adaptive < 2; adaptive++) {
+        BatchResult r = runBatch(adaptive != 0);
+        uint32_t p50 = percentile(r.latencyUs, 0.5);
+        uint32_t p99 = percentile(r.latencyUs, 0.99);
+        uint32_t maxUs = r.latencyUs.empty() ? 0 : *std::max_element(r.latencyUs.begin(), r.latencyUs.end());
+        printf("  %-8s оброблено %llu з %llu рядків (%.1f%%), втрачено %llu байт, %.1f KB/s\n",
+               names[adaptive], (unsigned long long)r.linesOut, (unsigned long long)r.linesIn,
+               r.linesIn > 0 ? 100.0 * r.linesOut / r.linesIn : 0.0, (unsigned long long)r.bytesLost,
+               r.linesOut * BATCH_LINE_BYTES / (BATCH_RUN_MS / 1000.0) / 1000.0);
+        printf("           затримка p50 %.1f мс, p99 %.1f мс, макс %.1f мс; циклів %u, найдовший %u мкс\n",
+               p50 / 1000.0, p99 / 1000.0, maxUs / 1000.0, (unsigned)r.cycles, (unsigned)r.maxCycleUs);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Режим decim: вартість проріджування при 50 тис. рядків/с.
+ *
+ * Рядки запису (або синтетичного потоку, переважно $ADC з різною кількістю
+ * полів) проходять LineDecimator з правилами прошивки. Час симульований:
+ * рядок i приходить на i * 1000 / DECIM_BENCH_RATE мс, тож вікна AGGREGATE
+ * закриваються так само, як на реальній швидкості потоку. Міряється
+ * process()+poll() на рядок і яку частку секунди CPU це займає при
+ * DECIM_BENCH_RATE рядків/с.
+ */
+#include <string.h>
+#include "native.h"
+#include "line_decimator.h"
+
+#define DECIM_BENCH_RATE 50000          // рядків/с
+#define DECIM_BENCH_SECONDS 4
+
+// Ті самі правила, що DECIMATION_RULES у прошивці
+static const DecimationRule BENCH_RULES[] = {
+    { "$ADC,", DecimationMode::AGGREGATE, 100 },
+    { "$RAW,", DecimationMode::INTERVAL, 100 },
+    { "$DBG,", DecimationMode::EVERY_N, 100 },
+};
+
+static void makeDecimInput(std::vector<uint8_t> &data) {
+    char line[128];
+    for (int i = 0; i < DECIM_BENCH_RATE * DECIM_BENCH_SECONDS; i++) {
+        int n;
+        switch (i % 10) {
+            case 8:
+                n = snprintf(line, sizeof(line), "$DBG,seq=%d\n", i);
+                break;
+            case 9:
+                n = snprintf(line, sizeof(line), "$RAW,%d,%d\n", i % 4096, (i * 3) % 4096);
+                break;
+            default:
+                // Четверте поле є не в кожному рядку - середнє рахується по своїх рядках
+                if (i % 3 == 0) {
+                    n = snprintf(line, sizeof(line), "$ADC,%d,%d.%02d,-%d\n", i % 4096, i % 50, i % 100, i % 17);
+                } else {
+                    n = snprintf(line, sizeof(line), "$ADC,%d,%d.%02d,-%d,%d\n", i % 4096, i % 50, i % 100, i % 17, 3300 - i % 7);
+                }
+                break;
+        }
+        data.insert(data.end(), line, line + n);
+    }
+}
+
+int benchDecim(const char *path) {
+    std::vector<uint8_t> input;
+    if (!loadInput(path, input, makeDecimInput)) return 1;
+
+    std::vector<std::pair<size_t, size_t>> lines;
+    size_t start = 0;
+    for (size_t i = 0; i < input.size(); i++) {
+        if (input[i] != '\n') continue;
+        size_t len = i - start;
+        if (len > 0 && input[i - 1] == '\r') len--;
+        lines.push_back(std::make_pair(start, len));
+        start = i + 1;
+    }
+
+    double bestNs = 0;
+    uint64_t emitted = 0;
+    DecimationStats st;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        LineDecimator decimator;
+        for (const DecimationRule &r : BENCH_RULES) decimator.addRule(r);
+        uint64_t out = 0;
+        auto emit = [&out](const char *line, size_t len) {
+            (void)line;
+            (void)len;
+            out++;
+        };
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lines.size(); i++) {
+            uint32_t nowMs = (uint32_t)((uint64_t)i * 1000 / DECIM_BENCH_RATE);
+            if (!decimator.process((const char *)input.data() + lines[i].first, lines[i].second, nowMs, emit)) out++;
+            // Обробник опитує вікна раз на пачку, тут - раз на мілісекунду потоку
+            if (i % (DECIM_BENCH_RATE / 1000) == 0) decimator.poll(nowMs, emit);
+        }
+        decimator.flush(emit);
+        double ns = secondsSince(t0) * 1e9 / (lines.empty() ? 1 : lines.size());
+
+        if (run == 0 || ns < bestNs) bestNs = ns;
+        emitted = out;
+        st = decimator.stats();
+    }
+
+    double seconds = (double)lines.size() / DECIM_BENCH_RATE;
+    printf("Вхід: %zu байт, %zu рядків (%.1f с потоку при %d рядків/с), найкращий з %d прогонів\n",
+           input.size(), lines.size(), seconds, DECIM_BENCH_RATE, BENCH_RUNS);
+    printf("  проріджування: %.1f нс/рядок, %.2f%% секунди CPU при %d рядків/с\n", bestNs,
+           bestNs * DECIM_BENCH_RATE / 1e7, DECIM_BENCH_RATE);
+    printf("  вихід %llu рядків (%.0f/с); за правилами %u, пропущено %u, агрегатів %u\n", (unsigned long long)emitted,
+           seconds > 0 ? emitted / seconds : 0.0, (unsigned)st.linesIn, (unsigned)st.linesPassed, (unsigned)st.aggregates);
+    return 0;
+}
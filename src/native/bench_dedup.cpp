@@ -0,0 +1,86 @@
+/*
+ * Режим dedup: скільки коштує і скільки економить згортання повторів.
+ *
+ * Прогін запису (з прошивки або будь-якого лог-файлу) через конвеєр, де
+ * зібрано тільки dedup, у режимах off / on / fuzzy. Без файлу - синтетичний
+ * потік з heartbeat'ами, статусами з лічильниками і унікальними рядками.
+ */
+#include "native.h"
+
+#define DEDUP_BENCH_LINES 200000
+
+struct DedupOnlyConfig : DefaultIngestConfig {
+    static constexpr bool decimation = false;
+    static constexpr bool telemetry = false;
+    static constexpr bool dedup = true;
+};
+
+static void makeDedupInput(std::vector<uint8_t> &data) {
+    char line[128];
+    for (int i = 0; i < DEDUP_BENCH_LINES; i++) {
+        int n;
+        int burst = i % 50;
+        if (burst < 30) {
+            n = snprintf(line, sizeof(line), "HB ok\n");
+        } else if (burst < 45) {
+            n = snprintf(line, sizeof(line), "status: uptime=%d rssi=-%d queue=%d\n", i / 10, 60 + i % 9, i % 4);
+        } else {
+            n = snprintf(line, sizeof(line), "event id=%d value=%d.%03d\n", i, i % 97, i % 1000);
+        }
+        data.insert(data.end(), line, line + n);
+    }
+}
+
+int benchDedup(const char *path) {
+    std::vector<uint8_t> input;
+    if (!loadInput(path, input, makeDedupInput)) return 1;
+
+    static uint8_t ringStorage[DedupOnlyConfig::ringBytes];
+    static char framerStorage[LINE_FRAMER_BUFFER_SIZE(DedupOnlyConfig::lineMaxLength)];
+    struct Mode {
+        const char *name;
+        bool on;
+        bool fuzzy;
+    };
+    const Mode modes[] = { { "off", false, false }, { "on", true, false }, { "fuzzy", true, true } };
+
+    printf("Вхід: %zu байт, найкращий з %d прогонів\n", input.size(), BENCH_RUNS);
+    uint64_t plainBytes = 0;
+    for (const Mode &m : modes) {
+        double bestNs = 0;
+        uint64_t lines = 0, bytes = 0;
+        DedupStats st;
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            LineBlockPool pool;
+            pool.begin(DedupOnlyConfig::blockCount, DedupOnlyConfig::blockBytes);
+            SinkFanout fanout;
+            HashSink sink;
+            fanout.add(&sink, MAX_SINK_QUEUE_DEPTH, OverflowPolicy::DROP_NEWEST);
+            ByteRing ring(ringStorage, sizeof(ringStorage));
+            LineFramer framer(framerStorage, sizeof(framerStorage));
+            FixedClock clock;
+            IngestPipeline<DedupOnlyConfig, FixedClock> pipeline(clock, pool, fanout);
+            pipeline.dedup(0)->configure(m.on, m.fuzzy, 10000);
+
+            auto t0 = std::chrono::steady_clock::now();
+            lines = runPipeline(pipeline, fanout, input, ring, framer, 1000000);
+            // Відкрита серія наприкінці запису - теж у вихід
+            pipeline.dedup(0)->flush([&pipeline](const char *p, size_t pn, const char *l, size_t n) {
+                pipeline.writer().append(p, pn, l, n);
+            });
+            pipeline.writer().publish();
+            fanout.service(0);
+            double ns = secondsSince(t0) * 1e9 / (lines > 0 ? lines : 1);
+
+            if (run == 0 || ns < bestNs) bestNs = ns;
+            bytes = sink.bytes;
+            st = pipeline.dedup(0)->stats();
+            pool.end();
+        }
+        if (!m.on) plainBytes = bytes;
+        printf("  %-6s %6.1f нс/рядок  вихід %9llu байт (%5.1f%%)  придушено %llu з %llu рядків, підсумків %u\n",
+               m.name, bestNs, (unsigned long long)bytes, plainBytes > 0 ? 100.0 * bytes / plainBytes : 100.0,
+               (unsigned long long)st.linesSuppressed, (unsigned long long)lines, (unsigned)st.summaries);
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Режим sinks: чи гальмує повільний sink швидкі.
+ *
+ * Продюсер протягом SINKS_RUN_MS публікує блоки так швидко, як дає пул.
+ * Швидкий sink (хеш у пам'яті) не губить нічого - продюсер чекає на його
+ * чергу, тому його швидкість і є пропускною здатністю конвеєра. Повільний
+ * sink (затримка на кожен write, як SD на 400 kHz SPI) має свою чергу і
+ * політику. Обидва обслуговуються власними потоками, як sink_writer_task
+ * у прошивці. Порівнюємо швидкий sink без повільного і поруч з ним.
+ */
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "native.h"
+
+#define SINKS_RUN_MS 1000
+#define SINKS_BLOCK_BYTES 4096
+#define SINKS_POOL_BLOCKS 32
+#define SINKS_SMALL_POOL_BLOCKS 16      // Менше за суму черг - повільний sink з'їдає пул
+#define SINKS_FAST_DEPTH 8
+#define SINKS_SLOW_DEPTH 16
+#define SINKS_SLOW_WRITE_MS 5           // ~4KB на SD за 5мс
+#define SINKS_BLOCK_TIMEOUT_MS 100
+#define SINKS_FAST_TIMEOUT_MS 1000      // Швидкий sink без втрат
+
+class SlowSink : public LogSink {
+public:
+    const char *name() const override { return "slow"; }
+    bool write(const LineBlock &block) override {
+        (void)block;
+        loggerSleepMs(SINKS_SLOW_WRITE_MS);
+        return true;
+    }
+};
+
+struct SinksResult {
+    double fastMBps;
+    double poolWaitMs;        // Продюсер без вільного блоку (у прошивці - втрачені рядки)
+    double blockedMs;         // Продюсер чекав на чергу повільного sink'а (BLOCK)
+    uint32_t fastDropped;
+    uint32_t slowWritten;
+    uint32_t slowDropped;
+};
+
+static SinksResult runSinks(bool withSlow, OverflowPolicy slowPolicy, size_t poolBlocks) {
+    LineBlockPool pool;
+    pool.begin(poolBlocks, SINKS_BLOCK_BYTES);
+    SinkFanout fanout;
+    HashSink fast;
+    SlowSink slow;
+    int fastIndex = fanout.add(&fast, SINKS_FAST_DEPTH, OverflowPolicy::BLOCK, SINKS_FAST_TIMEOUT_MS);
+    int slowIndex = withSlow ? fanout.add(&slow, SINKS_SLOW_DEPTH, slowPolicy, SINKS_BLOCK_TIMEOUT_MS) : -1;
+
+    std::atomic<bool> running(true);
+    auto serve = [&fanout, &running](int index) {
+        while (running.load()) {
+            if (fanout.service(index) == 0) std::this_thread::yield();
+        }
+        fanout.service(index);
+    };
+    std::thread fastThread(serve, fastIndex);
+    std::thread slowThread;
+    if (withSlow) slowThread = std::thread(serve, slowIndex);
+
+    char line[64];
+    memset(line, 'x', sizeof(line));
+    double poolWaitUs = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    while (secondsSince(t0) * 1000 < SINKS_RUN_MS) {
+        LineBlock *block = pool.acquire();
+        if (block == NULL) {
+            uint32_t t1 = loggerMicros();
+            std::this_thread::yield();
+            poolWaitUs += loggerMicros() - t1;
+            continue;
+        }
+        while (block->appendLine(line, sizeof(line) - 1)) {}
+        fanout.publish(block);
+    }
+    double elapsed = secondsSince(t0);
+    running.store(false);
+    fastThread.join();
+    if (withSlow) slowThread.join();
+
+    SinksResult r;
+    r.fastMBps = fast.bytes / elapsed / 1e6;
+    r.fastDropped = fanout.metrics(fastIndex).blocksDropped;
+    r.poolWaitMs = poolWaitUs / 1000.0;
+    r.blockedMs = withSlow ? fanout.metrics(slowIndex).blockedUs / 1000.0 : 0;
+    r.slowWritten = withSlow ? fanout.metrics(slowIndex).blocksWritten : 0;
+    r.slowDropped = withSlow ? fanout.metrics(slowIndex).blocksDropped : 0;
+    pool.end();
+    return r;
+}
+
+int benchSinks() {
+    struct Scenario {
+        const char *name;
+        bool withSlow;
+        OverflowPolicy policy;
+        size_t poolBlocks;
+    };
+    const Scenario scenarios[] = {
+        { "тільки швидкий", false, OverflowPolicy::DROP_NEWEST, SINKS_POOL_BLOCKS },
+        { "+ повільний, drop-newest", true, OverflowPolicy::DROP_NEWEST, SINKS_POOL_BLOCKS },
+        { "+ повільний, drop-oldest", true, OverflowPolicy::DROP_OLDEST, SINKS_POOL_BLOCKS },
+        { "+ повільний, block 100мс", true, OverflowPolicy::BLOCK, SINKS_POOL_BLOCKS },
+        { "+ повільний, drop-newest, пул < сума черг", true, OverflowPolicy::DROP_NEWEST, SINKS_SMALL_POOL_BLOCKS },
+    };
+
+    printf("Продюсер без обмеження швидкості, %d мс на сценарій; повільний sink: %d мс на блок %d байт\n",
+           SINKS_RUN_MS, SINKS_SLOW_WRITE_MS, SINKS_BLOCK_BYTES);
+    printf("Черги: швидкий %d, повільний %d; пул %d блоків\n", SINKS_FAST_DEPTH, SINKS_SLOW_DEPTH, SINKS_POOL_BLOCKS);
+    double baseline = 0;
+    for (const Scenario &s : scenarios) {
+        SinksResult r = runSinks(s.withSlow, s.policy, s.poolBlocks);
+        if (!s.withSlow) baseline = r.fastMBps;
+        printf("  швидкий %7.1f MB/s (%5.1f%%, втрат %u)  без блоку %6.1f мс  на повільний %6.1f мс  "
+               "повільний записав %u з %u  %s\n",
+               r.fastMBps, baseline > 0 ? 100.0 * r.fastMBps / baseline : 100.0, (unsigned)r.fastDropped,
+               r.poolWaitMs, r.blockedMs, (unsigned)r.slowWritten, (unsigned)(r.slowWritten + r.slowDropped), s.name);
+    }
+    return 0;
+}
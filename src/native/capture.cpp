@@ -0,0 +1,72 @@
+/*
+ * Режим capture: записаний потік через конвеєр у самописець, як у
+ * прошивці з "capture on". Вікна навколо тригерів пишуться у файли
+ * <prefix>_NNN_<причина>.txt (FileRecorderOutput), вивантаження - в
+ * окремому потоці, як recorder_dump_task.
+ */
+#include <atomic>
+#include <thread>
+#include "native.h"
+#include "flight_recorder.h"
+
+#define CAPTURE_RING_BYTES (4 * 1024 * 1024)   // Як LoggerPipelineConfig::recorderBytes
+#define CAPTURE_POST_TRIGGER_MS 10000
+#define CAPTURE_QUEUE_DEPTH 16
+
+int runCapture(const char *path, const char *prefix, const char *const *patterns, int patternCount) {
+    std::vector<uint8_t> input;
+    if (!readFile(path, input)) {
+        fprintf(stderr, "Не вдалося прочитати %s\n", path);
+        return 1;
+    }
+
+    FileRecorderOutput output(prefix);
+    FlightRecorder recorder;
+    if (!recorder.begin(CAPTURE_RING_BYTES, &output)) return 1;
+    FlightRecorderConfig cfg = { CAPTURE_POST_TRIGGER_MS, 0, 1024, 0 };
+    recorder.configure(cfg);
+    static const char *const defaults[] = { "Guru Meditation", "panic", "assert failed" };
+    if (patternCount == 0) {
+        patterns = defaults;
+        patternCount = sizeof(defaults) / sizeof(defaults[0]);
+    }
+    for (int i = 0; i < patternCount; i++) {
+        if (!recorder.addPattern(patterns[i])) fprintf(stderr, "Шаблон '%s' пропущено\n", patterns[i]);
+    }
+
+    static uint8_t ringStorage[DefaultIngestConfig::ringBytes];
+    static char framerStorage[LINE_FRAMER_BUFFER_SIZE(DefaultIngestConfig::lineMaxLength)];
+    LineBlockPool pool;
+    pool.begin(DefaultIngestConfig::blockCount, DefaultIngestConfig::blockBytes);
+    SinkFanout fanout;
+    // На хості sink обслуговується в тому ж циклі - BLOCK нікого не гальмує
+    fanout.add(&recorder, CAPTURE_QUEUE_DEPTH, OverflowPolicy::BLOCK, 1000);
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    UptimeClock clock;
+    IngestPipeline<DefaultIngestConfig, UptimeClock> pipeline(clock, pool, fanout);
+
+    std::atomic<bool> running(true);
+    std::thread dumper([&recorder, &running]() {
+        while (running.load()) {
+            if (!recorder.dump(loggerMillis())) loggerSleepMs(1);
+        }
+    });
+
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t lines = runPipeline(pipeline, fanout, input, ring, framer, 1000000);
+    double elapsed = secondsSince(t0);
+    running.store(false);
+    dumper.join();
+    // Кінець запису закриває відкрите вікно, навіть якщо postTriggerMs ще не минув
+    while (recorder.dump(loggerMillis() + CAPTURE_POST_TRIGGER_MS)) {}
+    recorder.dump(loggerMillis() + CAPTURE_POST_TRIGGER_MS);
+
+    const FlightRecorderStats &st = recorder.stats();
+    fprintf(stderr, "Оброблено %llu рядків, %zu байт за %.2f с\n", (unsigned long long)lines, input.size(), elapsed);
+    fprintf(stderr, "Тригерів: %u, вікон: %u, у кільце: %u байт, вивантажено: %u байт, втрачено: %u байт, помилок: %u\n",
+            (unsigned)st.triggers, (unsigned)st.captures, (unsigned)st.bytesRecorded, (unsigned)st.bytesDumped,
+            (unsigned)st.bytesLost, (unsigned)st.writeErrors);
+    pool.end();
+    return 0;
+}
@@ -0,0 +1,303 @@
+/*
+ * Нативна збірка логера (pio run -e native): той самий конвеєр прийому на ПК.
+ *
+ *   program replay <log> [out]   - прогнати записаний потік через конвеєр (out або stdout)
+ *   program capture <log> <prefix> [шаблон...] - той самий потік через самописець, вікна у файли
+ *   program bench [log]           - порівняти спеціалізований конвеєр із загальним шляхом
+ *   program sinks                 - повільний sink поруч зі швидким (політики переповнення)
+ *   program dedup [log]           - ціна і економія згортання повторів (off/on/fuzzy)
+ *   program telemetry [log]       - швидкість колонкового кодування і стиснення
+ *   program batch                 - затримка і втрати обробника під сплесками
+ *   program decim [log]           - вартість проріджування при 50 тис. рядків/с
+ *
+ * Загальний шлях - обробка рядка, як вона була до шаблонного конвеєра:
+ * вільні функції, глобальні етапи з перевіркою прапорців на кожен рядок,
+ * запис у блок через вказівник на функцію і заміри часу навколо кожного рядка.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "native.h"
+
+#ifdef LOGGER_TRACE
+Tracer tracer;
+#endif
+
+#define BENCH_LINES 200000
+
+// Повний конвеєр як у прошивці: етапи зібрані, вмикаються під час роботи
+struct NativeFullConfig : DefaultIngestConfig {};
+
+// Спеціалізований: framer -> timestamp -> блоки, решти етапів немає
+struct NativePlainConfig : DefaultIngestConfig {
+    static constexpr bool decimation = false;
+    static constexpr bool telemetry = false;
+    static constexpr bool dedup = false;
+};
+
+bool readFile(const char *path, std::vector<uint8_t> &data) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return false;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(fp);
+    return true;
+}
+
+bool loadInput(const char *path, std::vector<uint8_t> &data, void (*synthetic)(std::vector<uint8_t> &)) {
+    if (path == NULL) {
+        synthetic(data);
+        return true;
+    }
+    if (readFile(path, data)) return true;
+    fprintf(stderr, "Не вдалося прочитати %s\n", path);
+    return false;
+}
+
+// Синтетичний потік: телеметрія, статуси, heartbeat'и різної довжини
+static void makeBenchInput(std::vector<uint8_t> &data) {
+    char line[160];
+    for (int i = 0; i < BENCH_LINES; i++) {
+        int n;
+        switch (i % 4) {
+            case 0: n = snprintf(line, sizeof(line), "temp=%d.%02d hum=%d.%d seq=%d\n", 20 + i % 7, i % 100, 40 + i % 13, i % 10, i); break;
+            case 1: n = snprintf(line, sizeof(line), "$IMU,%d,%d,%d\n", i % 512 - 256, (i * 7) % 512 - 256, 1000 + i % 33); break;
+            case 2: n = snprintf(line, sizeof(line), "I (%d) wifi: sta rssi=%d, channel=%d, queue=%d/%d\n", i * 3, -40 - i % 30, 1 + i % 11, i % 16, 16); break;
+            default: n = snprintf(line, sizeof(line), "heartbeat ok\n"); break;
+        }
+        data.insert(data.end(), line, line + n);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Загальний шлях (до шаблонного конвеєра)
+// ---------------------------------------------------------------------------
+namespace generic {
+
+LineBlockPool *pool;
+SinkFanout *fanout;
+LineBlock *currentBlock = NULL;
+uint32_t linesLostNoBlock = 0;
+LineDecimator lineDecimator;
+TelemetryStore telemetryStore;
+LineDedup lineDedup;
+FixedClock clock;
+uint32_t lastSecondMs = 0;
+
+void publishCurrentBlock() {
+    if (currentBlock == NULL) return;
+    if (currentBlock->lines > 0) {
+        fanout->publish(currentBlock);
+    } else {
+        currentBlock->release();
+    }
+    currentBlock = NULL;
+}
+
+void appendToBlock(const char *prefix, size_t prefixLen, const char *line, size_t len) {
+    if (currentBlock == NULL) currentBlock = pool->acquire();
+    if (currentBlock == NULL) {
+        linesLostNoBlock++;
+        return;
+    }
+    if (!currentBlock->appendLine(prefix, prefixLen, line, len)) {
+        publishCurrentBlock();
+        currentBlock = pool->acquire();
+        if (currentBlock == NULL) {
+            linesLostNoBlock++;
+            return;
+        }
+        size_t maxLen = currentBlock->capacity - prefixLen - 1;
+        if (len > maxLen) len = maxLen;
+        currentBlock->appendLine(prefix, prefixLen, line, len);
+    }
+}
+
+void emitUndecimatedLine(const char *line, size_t len) {
+    if (telemetryStore.isEnabled() && telemetryStore.append(line, len, loggerMillis())) {
+        return;
+    }
+    uint32_t now = loggerMillis();
+    if (now - lastSecondMs >= 1000) {
+        clock.refresh();
+        lastSecondMs = now;
+    }
+    lineDedup.process(clock.prefix(), clock.length(), line, len, now, appendToBlock);
+}
+
+void emitLine(const char *line, size_t len) {
+    if (lineDecimator.isActive() && lineDecimator.process(line, len, loggerMillis(), emitUndecimatedLine)) {
+        return;
+    }
+    emitUndecimatedLine(line, len);
+}
+
+uint64_t run(const std::vector<uint8_t> &input, ByteRing &ring, LineFramer &framer, uint32_t budgetUs) {
+    uint32_t timeInEmit = 0;
+    auto emit = [&timeInEmit](const char *line, size_t len) {
+        uint32_t t1 = loggerMicros();
+        emitLine(line, len);
+        timeInEmit += loggerMicros() - t1;
+    };
+    uint64_t lines = 0;
+    for (size_t pos = 0; pos < input.size(); pos += NATIVE_CHUNK) {
+        size_t n = input.size() - pos < NATIVE_CHUNK ? input.size() - pos : NATIVE_CHUNK;
+        ring.write(input.data() + pos, n);
+        uint32_t cycleStart = loggerMicros();
+        uint32_t processed = 0;
+        while (processed < NATIVE_BATCH_LINES && loggerMicros() - cycleStart < budgetUs) {
+            if (!framer.next(ring, emit)) break;
+            processed++;
+        }
+        lines += processed;
+        lineDedup.poll(loggerMillis(), appendToBlock);
+        if (currentBlock != NULL && currentBlock->freeSpace() < 256) publishCurrentBlock();
+        fanout->service(0);
+    }
+    publishCurrentBlock();
+    fanout->service(0);
+    return lines;
+}
+
+}  // namespace generic
+
+struct BenchResult {
+    double nsPerLine;
+    uint64_t lines;
+    uint64_t hash;
+    uint64_t bytes;
+};
+
+static uint8_t ringStorage[DefaultIngestConfig::ringBytes];
+static char framerStorage[LINE_FRAMER_BUFFER_SIZE(DefaultIngestConfig::lineMaxLength)];
+
+// Найкращий із BENCH_RUNS прогонів - менше шуму від планувальника
+template <typename Run>
+BenchResult bench(Run &&run) {
+    BenchResult best = { 0, 0, 0, 0 };
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        LineBlockPool pool;
+        pool.begin(DefaultIngestConfig::blockCount, DefaultIngestConfig::blockBytes);
+        SinkFanout fanout;
+        HashSink sink;
+        fanout.add(&sink, MAX_SINK_QUEUE_DEPTH, OverflowPolicy::DROP_NEWEST);
+        ByteRing ring(ringStorage, sizeof(ringStorage));
+        LineFramer framer(framerStorage, sizeof(framerStorage));
+
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t lines = run(pool, fanout, ring, framer);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+        double perLine = lines > 0 ? ns / lines : 0;
+        if (i == 0 || perLine < best.nsPerLine) best.nsPerLine = perLine;
+        best.lines = lines;
+        best.hash = sink.hash;
+        best.bytes = sink.bytes;
+        pool.end();
+    }
+    return best;
+}
+
+int benchPipeline(const char *path) {
+    std::vector<uint8_t> input;
+    if (!loadInput(path, input, makeBenchInput)) return 1;
+    const uint32_t budgetUs = 1000000;   // Бюджет не обмежує - міряємо чисту обробку
+
+    BenchResult g = bench([&](LineBlockPool &pool, SinkFanout &fanout, ByteRing &ring, LineFramer &framer) {
+        generic::pool = &pool;
+        generic::fanout = &fanout;
+        generic::currentBlock = NULL;
+        return generic::run(input, ring, framer, budgetUs);
+    });
+
+    FixedClock clock;
+    BenchResult full = bench([&](LineBlockPool &pool, SinkFanout &fanout, ByteRing &ring, LineFramer &framer) {
+        IngestPipeline<NativeFullConfig, FixedClock> pipeline(clock, pool, fanout);
+        return runPipeline(pipeline, fanout, input, ring, framer, budgetUs);
+    });
+    BenchResult plain = bench([&](LineBlockPool &pool, SinkFanout &fanout, ByteRing &ring, LineFramer &framer) {
+        IngestPipeline<NativePlainConfig, FixedClock> pipeline(clock, pool, fanout);
+        return runPipeline(pipeline, fanout, input, ring, framer, budgetUs);
+    });
+
+    printf("Вхід: %zu байт, %llu рядків, найкращий з %d прогонів\n",
+           input.size(), (unsigned long long)g.lines, BENCH_RUNS);
+    const BenchResult *results[] = { &g, &full, &plain };
+    const char *names[] = { "загальний (до шаблонів)", "шаблонний, всі етапи", "шаблонний, спеціалізований" };
+    for (int i = 0; i < 3; i++) {
+        double mbps = results[i]->nsPerLine > 0 ? (double)input.size() / results[i]->lines / results[i]->nsPerLine * 1000.0 : 0;
+        printf("  %7.1f нс/рядок  %7.1f MB/s  %s\n", results[i]->nsPerLine, mbps, names[i]);
+    }
+
+    // Вихід має бути однаковим - інакше порівнювати немає чого
+    bool same = g.hash == full.hash && g.hash == plain.hash && g.bytes == plain.bytes;
+    printf("Вихід: %llu байт, %s\n", (unsigned long long)g.bytes, same ? "однаковий у всіх шляхів" : "РІЗНИЙ!");
+    return same ? 0 : 1;
+}
+
+int runReplay(const char *path, const char *outPath) {
+    std::vector<uint8_t> input;
+    if (!readFile(path, input)) {
+        fprintf(stderr, "Не вдалося прочитати %s\n", path);
+        return 1;
+    }
+    FILE *out = outPath != NULL ? fopen(outPath, "wb") : stdout;
+    if (out == NULL) {
+        fprintf(stderr, "Не вдалося створити %s\n", outPath);
+        return 1;
+    }
+
+    LineBlockPool pool;
+    pool.begin(NativeFullConfig::blockCount, NativeFullConfig::blockBytes);
+    SinkFanout fanout;
+    FileSink sink(out);
+    fanout.add(&sink, MAX_SINK_QUEUE_DEPTH, OverflowPolicy::BLOCK, 1000);
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+
+    UptimeClock clock;
+    IngestPipeline<NativeFullConfig, UptimeClock> pipeline(clock, pool, fanout);
+    uint64_t lines = runPipeline(pipeline, fanout, input, ring, framer, 1000000);
+
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "Оброблено %llu рядків, %zu байт\n", (unsigned long long)lines, input.size());
+    pool.end();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+        return runReplay(argv[2], argc >= 4 ? argv[3] : NULL);
+    }
+    if (argc >= 4 && strcmp(argv[1], "capture") == 0) {
+        return runCapture(argv[2], argv[3], argv + 4, argc - 4);
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        return benchPipeline(argc >= 3 ? argv[2] : NULL);
+    }
+    if (argc >= 2 && strcmp(argv[1], "sinks") == 0) {
+        return benchSinks();
+    }
+    if (argc >= 2 && strcmp(argv[1], "dedup") == 0) {
+        return benchDedup(argc >= 3 ? argv[2] : NULL);
+    }
+    if (argc >= 2 && strcmp(argv[1], "telemetry") == 0) {
+        return benchTelemetry(argc >= 3 ? argv[2] : NULL);
+    }
+    if (argc >= 2 && strcmp(argv[1], "batch") == 0) {
+        return benchBatch();
+    }
+    if (argc >= 2 && strcmp(argv[1], "decim") == 0) {
+        return benchDecim(argc >= 3 ? argv[2] : NULL);
+    }
+    fprintf(stderr, "Використання:\n"
+                    "  %s replay <log> [out]\n"
+                    "  %s capture <log> <prefix> [pattern...]\n"
+                    "  %s bench [log]\n"
+                    "  %s sinks\n"
+                    "  %s dedup [log]\n"
+                    "  %s telemetry [log]\n"
+                    "  %s batch\n"
+                    "  %s decim [log]\n", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+}
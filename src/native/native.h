@@ -0,0 +1,83 @@
+/*
+ * Спільне для режимів нативної збірки (src/native): вхідні дані, sink'и
+ * для замірів і оголошення режимів. Кожен режим - окремий .cpp.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+#include "ingest_pipeline.h"
+
+#define NATIVE_CHUNK 512            // Як один USB transfer
+#define BENCH_RUNS 5                // Беремо найкращий прогін - менше шуму від планувальника
+#define NATIVE_BATCH_LINES 512
+
+// Незмінний префікс - виходи різних шляхів можна порівняти побайтно
+class FixedClock {
+public:
+    const char *prefix() const { return "[bench] "; }
+    size_t length() const { return 8; }
+    void setTag(const char *tag) { (void)tag; }
+    void refresh() {}
+    void tick(uint32_t nowMs) { (void)nowMs; }
+    uint64_t unixMs(uint32_t nowMs) const { return nowMs; }
+};
+
+// Контрольна сума виходу без збереження всього тексту
+class HashSink : public LogSink {
+public:
+    HashSink() : hash(1469598103934665603ULL), bytes(0) {}
+    const char *name() const override { return "hash"; }
+    bool write(const LineBlock &block) override {
+        for (uint32_t i = 0; i < block.length; i++) {
+            hash = (hash ^ (uint8_t)block.data[i]) * 1099511628211ULL;
+        }
+        bytes += block.length;
+        return true;
+    }
+    uint64_t hash;
+    uint64_t bytes;
+};
+
+inline double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Вхід порціями по NATIVE_CHUNK, після кожної - пачка і обслуговування, як у прошивці
+template <typename Pipeline>
+uint64_t runPipeline(Pipeline &pipeline, SinkFanout &fanout, const std::vector<uint8_t> &input,
+                     ByteRing &ring, LineFramer &framer, uint32_t budgetUs) {
+    uint64_t lines = 0;
+    for (size_t pos = 0; pos < input.size(); pos += NATIVE_CHUNK) {
+        size_t n = input.size() - pos < NATIVE_CHUNK ? input.size() - pos : NATIVE_CHUNK;
+        ring.write(input.data() + pos, n);
+        uint32_t cycleStart = loggerMicros();
+        auto withinBudget = [cycleStart, budgetUs]() { return loggerMicros() - cycleStart < budgetUs; };
+        pipeline.beginBatch(ring.size(), NATIVE_BATCH_LINES);
+        bool drained;
+        lines += pipeline.drain(0, ring, framer, "", NATIVE_BATCH_LINES, withinBudget, drained);
+        pipeline.poll(loggerMillis());
+        fanout.service(0);
+    }
+    pipeline.finish(0, framer, "");
+    pipeline.writer().publish();
+    fanout.service(0);
+    return lines;
+}
+
+bool readFile(const char *path, std::vector<uint8_t> &data);
+
+// Вхід режиму: файл або синтетичний потік. false - файл не прочитано
+bool loadInput(const char *path, std::vector<uint8_t> &data, void (*synthetic)(std::vector<uint8_t> &));
+
+// Режими (повертають код виходу процесу)
+int benchPipeline(const char *path);
+int runReplay(const char *path, const char *outPath);
+int runCapture(const char *path, const char *prefix, const char *const *patterns, int patternCount);
+int benchSinks();
+int benchDedup(const char *path);
+int benchTelemetry(const char *path);
+int benchBatch();
+int benchDecim(const char *path);
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+Telemetry Export - читає колонковий файл телеметрії (.tlm) з SD карти
+і експортує вибрані канали в CSV.
+
+Читаються тільки потрібні колонки: решта пропускається за довжинами
+з заголовка блоку, тому кілька каналів за тиждень - це кілобайти читання.
+
+Приклади:
+    python telemetry_export.py log_20250928_120000.tlm --list
+    python telemetry_export.py log_20250928_120000.tlm --schema env --fields temp -o temp.csv
+"""
+
+import argparse
+import csv
+import datetime
+import struct
+import sys
+
+
+def read_varints(data, count):
+    """Декодує count zigzag-varint дельт і повертає абсолютні значення"""
+    values = []
+    pos = 0
+    current = 0
+    for i in range(count):
+        shift = 0
+        raw = 0
+        while True:
+            byte = data[pos]
+            pos += 1
+            raw |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        delta = (raw >> 1) ^ -(raw & 1)
+        current = delta if i == 0 else current + delta
+        values.append(current)
+    return values
+
+
+def read_header(f):
+    """Читає опис схем з початку файлу"""
+    if f.read(4) != b"TLM1":
+        raise ValueError("Це не файл телеметрії (немає сигнатури TLM1)")
+    schemas = {}
+    (count,) = struct.unpack("<B", f.read(1))
+    for _ in range(count):
+        schema_id, decimals, field_count, name_len = struct.unpack("<BBBB", f.read(4))
+        name = f.read(name_len).decode("utf-8")
+        fields = []
+        for _ in range(field_count):
+            (field_len,) = struct.unpack("<B", f.read(1))
+            fields.append(f.read(field_len).decode("utf-8"))
+        schemas[schema_id] = {"name": name, "decimals": decimals, "fields": fields}
+    return schemas
+
+
+def iter_blocks(f, schema_id, wanted_columns):
+    """Повертає (час, {колонка: значення}) тільки для потрібних колонок"""
+    while True:
+        header = f.read(6)
+        if len(header) < 6:
+            return
+        magic, block_schema, column_count, row_count = struct.unpack("<2sBBH", header)
+        if magic != b"TB":
+            raise ValueError(f"Пошкоджений блок на позиції {f.tell() - 6}")
+        lengths = struct.unpack(f"<{column_count}I", f.read(4 * column_count))
+
+        if block_schema != schema_id:
+            f.seek(sum(lengths), 1)  # Чужа схема - пропускаємо цілий блок
+            continue
+
+        columns = {}
+        for col, length in enumerate(lengths):
+            if col in wanted_columns:
+                columns[col] = read_varints(f.read(length), row_count)
+            else:
+                f.seek(length, 1)  # Непотрібний канал - не читаємо
+        for row in range(row_count):
+            yield {col: values[row] for col, values in columns.items()}
+
+
+def export(path, schema_name, field_names, output, unix_time):
+    with open(path, "rb") as f:
+        schemas = read_header(f)
+        matches = [sid for sid, s in schemas.items() if s["name"] == schema_name]
+        if not matches:
+            names = ", ".join(s["name"] for s in schemas.values())
+            raise ValueError(f"Схему '{schema_name}' не знайдено. Є: {names}")
+        schema_id = matches[0]
+        schema = schemas[schema_id]
+
+        if not field_names:
+            field_names = schema["fields"]
+        columns = [0]
+        for name in field_names:
+            if name not in schema["fields"]:
+                raise ValueError(f"Поля '{name}' немає в схемі '{schema_name}'")
+            columns.append(schema["fields"].index(name) + 1)
+
+        scale = 10 ** schema["decimals"]
+        writer = csv.writer(output)
+        writer.writerow(["time"] + list(field_names))
+        rows = 0
+        for row in iter_blocks(f, schema_id, set(columns)):
+            time_ms = row[0]
+            if unix_time:
+                stamp = f"{time_ms / 1000.0:.3f}"
+            else:
+                # RTC зберігає локальний час, тому перетворюємо без зсуву часового поясу
+                stamp = datetime.datetime.utcfromtimestamp(time_ms / 1000.0).strftime("%Y-%m-%d %H:%M:%S.%f")[:-3]
+            writer.writerow([stamp] + [row[c] / scale for c in columns[1:]])
+            rows += 1
+        return rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Експорт колонкової телеметрії (.tlm) в CSV")
+    parser.add_argument("file", help="файл .tlm з SD карти")
+    parser.add_argument("--list", action="store_true", help="показати схеми і поля")
+    parser.add_argument("--schema", help="назва схеми для експорту")
+    parser.add_argument("--fields", help="поля через кому (за замовчуванням - всі)")
+    parser.add_argument("--unix", action="store_true", help="час як Unix секунди замість дати")
+    parser.add_argument("-o", "--output", help="CSV файл (за замовчуванням - stdout)")
+    args = parser.parse_args()
+
+    try:
+        if args.list or not args.schema:
+            with open(args.file, "rb") as f:
+                for sid, s in read_header(f).items():
+                    print(f"{s['name']} (id {sid}, знаків після коми: {s['decimals']}): {', '.join(s['fields'])}")
+            return 0
+
+        fields = args.fields.split(",") if args.fields else None
+        if args.output:
+            with open(args.output, "w", newline="") as out:
+                rows = export(args.file, args.schema, fields, out, args.unix)
+            print(f"Експортовано {rows} рядків у {args.output}", file=sys.stderr)
+        else:
+            export(args.file, args.schema, fields, sys.stdout, args.unix)
+        return 0
+    except (OSError, ValueError) as e:
+        print(f"❌ Помилка: {e}", file=sys.stderr)
+        return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,191 @@
+/*
+ * FlightRecorder: тригери, передісторія, межі вікон і вивантаження
+ * в окремому потоці паралельно із записом у кільце.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "flight_recorder.h"
+
+class MemoryOutput : public FlightRecorderOutput {
+public:
+    MemoryOutput() : opens(0), closes(0), failOpen(false) {}
+    bool open(const char *reason) override {
+        if (failOpen) return false;
+        opens++;
+        lastReason = reason;
+        windows.push_back(std::string());
+        return true;
+    }
+    bool write(const char *data, size_t len) override {
+        windows.back().append(data, len);
+        return true;
+    }
+    void close() override { closes++; }
+
+    int opens;
+    int closes;
+    bool failOpen;
+    std::string lastReason;
+    std::vector<std::string> windows;
+};
+
+static LineBlockPool pool;
+static MemoryOutput output;
+
+void setUp(void) {
+    pool.begin(4, 512);
+    output = MemoryOutput();
+}
+void tearDown(void) { pool.end(); }
+
+static void feed(FlightRecorder &fr, const char *text) {
+    LineBlock *block = pool.acquire();
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_TRUE(block->appendLine(text, strlen(text)));
+    fr.write(*block);
+    block->release();
+}
+
+static void configure(FlightRecorder &fr, size_t bytes, uint32_t postMs) {
+    TEST_ASSERT_TRUE(fr.begin(bytes, &output));
+    FlightRecorderConfig cfg = { postMs, 0, 1024, 0 };
+    fr.configure(cfg);
+    fr.addPattern("panic");
+}
+
+static void test_nothing_dumped_without_trigger(void) {
+    FlightRecorder fr;
+    configure(fr, 1024, 0);
+    feed(fr, "normal");
+    fr.poll(loggerMillis());
+    TEST_ASSERT_FALSE(fr.dump(loggerMillis()));
+    TEST_ASSERT_EQUAL(0, output.opens);
+    TEST_ASSERT_EQUAL(7, fr.buffered());
+}
+
+// write() лише позначає тригер - файл відкриває і пише dump()
+static void test_pattern_dumps_history_in_dump_only(void) {
+    FlightRecorder fr;
+    configure(fr, 1024, 0);
+    feed(fr, "before");
+    feed(fr, "kernel panic");
+    TEST_ASSERT_TRUE(fr.isCapturing());
+    TEST_ASSERT_EQUAL(0, output.opens);
+    fr.dump(loggerMillis());
+    TEST_ASSERT_EQUAL(1, output.opens);
+    TEST_ASSERT_EQUAL(1, output.closes);
+    TEST_ASSERT_EQUAL_STRING("pattern", output.lastReason.c_str());
+    TEST_ASSERT_EQUAL_STRING("before\nkernel panic\n", output.windows[0].c_str());
+    TEST_ASSERT_FALSE(fr.isCapturing());
+}
+
+static void test_post_trigger_window(void) {
+    FlightRecorder fr;
+    configure(fr, 1024, 1000);
+    feed(fr, "panic");
+    uint32_t now = loggerMillis();
+    TEST_ASSERT_FALSE(fr.dump(now));
+    feed(fr, "after");
+    fr.dump(now + 10);
+    TEST_ASSERT_EQUAL(0, output.closes);
+    fr.dump(now + 2000);
+    TEST_ASSERT_EQUAL(1, output.closes);
+    TEST_ASSERT_EQUAL_STRING("panic\nafter\n", output.windows[0].c_str());
+}
+
+// Наступне вікно не повторює вже вивантажене
+static void test_second_window_starts_after_first(void) {
+    FlightRecorder fr;
+    configure(fr, 1024, 0);
+    feed(fr, "a panic");
+    fr.dump(loggerMillis());
+    feed(fr, "between");
+    fr.trigger();
+    fr.poll(loggerMillis());
+    fr.dump(loggerMillis());
+    TEST_ASSERT_EQUAL(2, output.windows.size());
+    TEST_ASSERT_EQUAL_STRING("between\n", output.windows[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("manual", output.lastReason.c_str());
+}
+
+// Кільце переповнене до тригера - вікно з першого повного рядка
+static void test_overwritten_history_starts_at_full_line(void) {
+    FlightRecorder fr;
+    configure(fr, 64, 0);
+    for (int i = 0; i < 20; i++) feed(fr, "line-0123456789");
+    feed(fr, "panic");
+    fr.dump(loggerMillis());
+    const std::string &w = output.windows[0];
+    TEST_ASSERT_EQUAL(0, w.compare(0, 16, "line-0123456789\n"));
+    TEST_ASSERT_EQUAL(0, w.compare(w.size() - 6, 6, "panic\n"));
+    TEST_ASSERT_EQUAL(6, w.size() % 16);
+}
+
+static void test_open_failure_rearms(void) {
+    FlightRecorder fr;
+    configure(fr, 1024, 0);
+    output.failOpen = true;
+    feed(fr, "panic");
+    fr.dump(loggerMillis());
+    TEST_ASSERT_EQUAL(1, fr.stats().writeErrors);
+    TEST_ASSERT_FALSE(fr.isCapturing());
+}
+
+// Запис і вивантаження в різних потоках: у вікні тільки цілі рядки по порядку,
+// пропуски лише там, де кільце обігнало вивантаження (bytesLost)
+static void test_concurrent_record_and_dump(void) {
+    FlightRecorder fr;
+    configure(fr, 4096, 60000);
+    const int lines = 20000;
+    std::atomic<bool> done(false);
+    std::thread dumper([&]() {
+        while (!done.load()) {
+            if (!fr.dump(loggerMillis())) std::this_thread::yield();
+        }
+        while (fr.dump(loggerMillis())) {}
+    });
+    feed(fr, "panic");
+    char line[32];
+    for (int i = 0; i < lines; i++) {
+        snprintf(line, sizeof(line), "seq %08d", i);
+        feed(fr, line);
+    }
+    done.store(true);
+    dumper.join();
+
+    // Рядок-тригер теж міг бути перезаписаний, поки потік вивантаження відкривав вихід
+    const std::string &w = output.windows[0];
+    size_t start = w.compare(0, 6, "panic\n") == 0 ? 6 : 0;
+    int last = -1;
+    uint64_t missing = start == 6 ? 0 : 6;
+    for (size_t pos = start; pos < w.size(); pos += 13) {
+        TEST_ASSERT_EQUAL(0, w.compare(pos, 4, "seq "));
+        TEST_ASSERT_EQUAL('\n', w[pos + 12]);
+        int seq = atoi(w.substr(pos + 4, 8).c_str());
+        TEST_ASSERT_GREATER_THAN(last, seq);
+        missing += (uint64_t)(seq - last - 1) * 13;
+        last = seq;
+    }
+    TEST_ASSERT_EQUAL(lines - 1, last);
+    // Пропущені байти - перезаписані (bytesLost) плюс обрізаний початок першого рядка після них
+    TEST_ASSERT_LESS_OR_EQUAL(missing, fr.stats().bytesLost);
+    TEST_ASSERT_EQUAL(fr.stats().bytesRecorded, fr.stats().bytesDumped + missing);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_nothing_dumped_without_trigger);
+    RUN_TEST(test_pattern_dumps_history_in_dump_only);
+    RUN_TEST(test_post_trigger_window);
+    RUN_TEST(test_second_window_starts_after_first);
+    RUN_TEST(test_overwritten_history_starts_at_full_line);
+    RUN_TEST(test_open_failure_rearms);
+    RUN_TEST(test_concurrent_record_and_dump);
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+/*
+ * IngestPipeline: проріджування і повтори окремо для кожного потоку,
+ * рядки з poll() - з тегом свого потоку.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "ingest_pipeline.h"
+
+struct TestConfig : DefaultIngestConfig {
+    static constexpr size_t blockCount = 8;
+    static constexpr int streams = 3;
+    static constexpr bool telemetry = false;
+};
+
+// Штамп без часу - в рядках видно тільки тег
+class TagClock {
+public:
+    TagClock() : len(0) { setTag(""); }
+    const char *prefix() const { return buf; }
+    size_t length() const { return len; }
+    void setTag(const char *tag) { len = (size_t)snprintf(buf, sizeof(buf), "[T] %s", tag); }
+    void refresh() {}
+    void tick(uint32_t nowMs) { (void)nowMs; }
+    uint64_t unixMs(uint32_t nowMs) const { return nowMs; }
+
+private:
+    char buf[32];
+    size_t len;
+};
+
+static LineBlockPool pool;
+static char memory[4096];
+
+void setUp(void) { pool.begin(TestConfig::blockCount, TestConfig::blockBytes); }
+void tearDown(void) { pool.end(); }
+
+// Усе, що конвеєр встиг віддати, по рядках
+static std::vector<std::string> collect(IngestPipeline<TestConfig, TagClock> &pipeline, SinkFanout &fanout,
+                                        MemorySink &sink) {
+    pipeline.writer().publish();
+    fanout.service(0);
+    std::vector<std::string> lines;
+    std::string all(sink.data(), sink.length());
+    size_t start = 0;
+    for (size_t nl; (nl = all.find('\n', start)) != std::string::npos; start = nl + 1) {
+        lines.push_back(all.substr(start, nl - start));
+    }
+    return lines;
+}
+
+static void feed(IngestPipeline<TestConfig, TagClock> &pipeline, int stream, const char *tag, const char *line) {
+    pipeline.setStream(stream, tag);
+    pipeline.line(stream, line, strlen(line));
+}
+
+// Однакові рядки двох інтерфейсів упереміш - дві окремі серії, а не одна змішана
+static void test_dedup_runs_per_stream(void) {
+    TagClock clock;
+    SinkFanout fanout;
+    MemorySink sink(memory, sizeof(memory));
+    fanout.add(&sink, 8, OverflowPolicy::DROP_NEWEST);
+    IngestPipeline<TestConfig, TagClock> pipeline(clock, pool, fanout);
+    for (int s = 0; s < pipeline.streams(); s++) pipeline.dedup(s)->configure(true, false, 10000);
+
+    for (int i = 0; i < 4; i++) {
+        feed(pipeline, 1, "[if0] ", "heartbeat");
+        feed(pipeline, 2, "[if2] ", "heartbeat");
+    }
+    feed(pipeline, 0, "[USB] ", "DCD=1");
+    pipeline.poll(loggerMillis() + 20000);
+
+    std::vector<std::string> lines = collect(pipeline, fanout, sink);
+    TEST_ASSERT_EQUAL(5, lines.size());
+    TEST_ASSERT_TRUE(lines[0] == "[T] [if0] heartbeat");
+    TEST_ASSERT_TRUE(lines[1] == "[T] [if2] heartbeat");
+    TEST_ASSERT_TRUE(lines[2] == "[T] [USB] DCD=1");
+    TEST_ASSERT_TRUE(lines[3] == "[T] [if0] repeated 3 times between [T] [if0] and [T] [if0]");
+    TEST_ASSERT_TRUE(lines[4] == "[T] [if2] repeated 3 times between [T] [if2] and [T] [if2]");
+}
+
+// Вікна $ADC окремі, агрегат з poll() - з тегом свого потоку, а не останнього drain()
+static void test_aggregates_per_stream_with_own_tag(void) {
+    TagClock clock;
+    SinkFanout fanout;
+    MemorySink sink(memory, sizeof(memory));
+    fanout.add(&sink, 8, OverflowPolicy::DROP_NEWEST);
+    IngestPipeline<TestConfig, TagClock> pipeline(clock, pool, fanout);
+    DecimationRule rule = { "$ADC,", DecimationMode::AGGREGATE, 100 };
+    for (int s = 0; s < pipeline.streams(); s++) pipeline.decimator(s)->addRule(rule);
+
+    feed(pipeline, 1, "[if0] ", "$ADC,1");
+    feed(pipeline, 2, "[if2] ", "$ADC,100");
+    feed(pipeline, 1, "[if0] ", "$ADC,3");
+    pipeline.setStream(0, "[USB] ");
+    pipeline.poll(loggerMillis() + 1000);
+
+    std::vector<std::string> lines = collect(pipeline, fanout, sink);
+    TEST_ASSERT_EQUAL(2, lines.size());
+    TEST_ASSERT_TRUE(lines[0] == "[T] [if0] $ADC,agg n=2 min=[1.000] max=[3.000] mean=[2.000]");
+    TEST_ASSERT_TRUE(lines[1] == "[T] [if2] $ADC,agg n=1 min=[100.000] max=[100.000] mean=[100.000]");
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_dedup_runs_per_stream);
+    RUN_TEST(test_aggregates_per_stream_with_own_tag);
+    return UNITY_END();
+}
@@ -0,0 +1,100 @@
+/*
+ * LineDecimator: режими проріджування і агрегати вікна.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "line_decimator.h"
+
+static std::vector<std::string> out;
+
+static void collect(const char *line, size_t len) { out.push_back(std::string(line, len)); }
+
+void setUp(void) { out.clear(); }
+void tearDown(void) {}
+
+static bool feed(LineDecimator &d, const char *line, uint32_t nowMs) {
+    return d.process(line, strlen(line), nowMs, collect);
+}
+
+static void test_every_n(void) {
+    LineDecimator d;
+    DecimationRule rule = { "$DBG,", DecimationMode::EVERY_N, 3 };
+    TEST_ASSERT_TRUE(d.addRule(rule));
+    int passed = 0;
+    for (int i = 0; i < 9; i++) passed += feed(d, "$DBG,x", i) ? 0 : 1;
+    TEST_ASSERT_EQUAL(3, passed);
+    TEST_ASSERT_FALSE(feed(d, "other", 0));
+}
+
+static void test_interval(void) {
+    LineDecimator d;
+    DecimationRule rule = { "$RAW,", DecimationMode::INTERVAL, 100 };
+    d.addRule(rule);
+    TEST_ASSERT_FALSE(feed(d, "$RAW,1", 0));
+    TEST_ASSERT_TRUE(feed(d, "$RAW,2", 99));
+    TEST_ASSERT_FALSE(feed(d, "$RAW,3", 100));
+}
+
+static void test_aggregate_window(void) {
+    LineDecimator d;
+    DecimationRule rule = { "$ADC,", DecimationMode::AGGREGATE, 100 };
+    d.addRule(rule);
+    TEST_ASSERT_TRUE(feed(d, "$ADC,1,-2", 0));
+    TEST_ASSERT_TRUE(feed(d, "$ADC,3,-4", 50));
+    d.poll(99, collect);
+    TEST_ASSERT_EQUAL(0, out.size());
+    d.poll(100, collect);
+    TEST_ASSERT_EQUAL(1, out.size());
+    TEST_ASSERT_EQUAL_STRING("$ADC,agg n=2 min=[1.000,-4.000] max=[3.000,-2.000] mean=[2.000,-3.000]", out[0].c_str());
+}
+
+// Поле, що з'явилось посеред вікна, усереднюється тільки по своїх рядках
+static void test_mean_per_field_count(void) {
+    LineDecimator d;
+    DecimationRule rule = { "$ADC,", DecimationMode::AGGREGATE, 100 };
+    d.addRule(rule);
+    feed(d, "$ADC,1,2.5", 0);
+    feed(d, "$ADC,3", 10);
+    feed(d, "$ADC,5,0.5", 20);
+    d.flush(collect);
+    TEST_ASSERT_EQUAL_STRING("$ADC,agg n=3 min=[1.000,0.500] max=[5.000,2.500] mean=[3.000,1.500]", out[0].c_str());
+
+    // Нове вікно не успадковує лічильники попереднього
+    feed(d, "$ADC,7", 200);
+    feed(d, "$ADC,9,4", 210);
+    d.flush(collect);
+    TEST_ASSERT_EQUAL_STRING("$ADC,agg n=2 min=[7.000,4.000] max=[9.000,4.000] mean=[8.000,4.000]", out[1].c_str());
+}
+
+static void test_numbers_after_letters_ignored(void) {
+    LineDecimator d;
+    DecimationRule rule = { "$ADC,", DecimationMode::AGGREGATE, 100 };
+    d.addRule(rule);
+    feed(d, "$ADC,ch2=10mV", 0);
+    d.flush(collect);
+    TEST_ASSERT_EQUAL_STRING("$ADC,agg n=1 min=[10.000] max=[10.000] mean=[10.000]", out[0].c_str());
+}
+
+static void test_passthrough(void) {
+    LineDecimator d;
+    DecimationRule rule = { "$DBG,", DecimationMode::EVERY_N, 100 };
+    d.addRule(rule);
+    d.setPassthrough(true);
+    TEST_ASSERT_FALSE(d.isActive());
+    for (int i = 0; i < 5; i++) TEST_ASSERT_FALSE(feed(d, "$DBG,x", i));
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_every_n);
+    RUN_TEST(test_interval);
+    RUN_TEST(test_aggregate_window);
+    RUN_TEST(test_mean_per_field_count);
+    RUN_TEST(test_numbers_after_letters_ignored);
+    RUN_TEST(test_passthrough);
+    return UNITY_END();
+}
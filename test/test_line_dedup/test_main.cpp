@@ -0,0 +1,106 @@
+/*
+ * LineDedup: серії повторів, fuzzy, обмеження затримки і зміна режиму.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <string>
+#include "line_dedup.h"
+
+static std::string out;
+static LineDedup dedup;
+
+static void collect(const char *prefix, size_t prefixLen, const char *line, size_t len) {
+    out.append(prefix, prefixLen);
+    out.append(line, len);
+    out += '\n';
+}
+
+static void feed(const char *stamp, const char *line, uint32_t nowMs) {
+    dedup.process(stamp, strlen(stamp), line, strlen(line), nowMs, collect);
+}
+
+void setUp(void) {
+    out.clear();
+    dedup.reset();
+    dedup.configure(true, false, 1000);
+}
+void tearDown(void) {}
+
+static void test_run_collapses_to_summary(void) {
+    feed("[1] ", "HB", 0);
+    feed("[2] ", "HB", 1);
+    feed("[3] ", "HB", 2);
+    feed("[4] ", "other", 3);
+    TEST_ASSERT_EQUAL_STRING("[1] HB\n[3] repeated 2 times between [2] and [3]\n[4] other\n", out.c_str());
+    TEST_ASSERT_EQUAL(2, dedup.stats().linesSuppressed);
+}
+
+static void test_single_repeat_passes_verbatim(void) {
+    feed("[1] ", "HB", 0);
+    feed("[2] ", "HB", 1);
+    feed("[3] ", "x", 2);
+    TEST_ASSERT_EQUAL_STRING("[1] HB\n[2] HB\n[3] x\n", out.c_str());
+    TEST_ASSERT_EQUAL(0, dedup.stats().linesSuppressed);
+}
+
+static void test_fuzzy_ignores_numbers(void) {
+    dedup.configure(true, true, 1000);
+    feed("[1] ", "rssi=-67", 0);
+    feed("[2] ", "rssi=-70", 1);
+    feed("[3] ", "rssi=-101", 2);
+    dedup.flush(collect);
+    TEST_ASSERT_EQUAL_STRING("[1] rssi=-67\n[3] repeated 2 times between [2] and [3]\n", out.c_str());
+}
+
+static void test_poll_bounds_hold_time(void) {
+    feed("[1] ", "HB", 0);
+    feed("[2] ", "HB", 100);
+    feed("[3] ", "HB", 200);
+    dedup.poll(1099, collect);
+    TEST_ASSERT_EQUAL_STRING("[1] HB\n", out.c_str());
+    dedup.poll(1100, collect);
+    TEST_ASSERT_EQUAL_STRING("[1] HB\n[3] repeated 2 times between [2] and [3]\n", out.c_str());
+}
+
+// Вимкнення посеред серії не губить придушені рядки
+static void test_mode_change_flushes_open_run(void) {
+    feed("[1] ", "HB", 0);
+    feed("[2] ", "HB", 1);
+    feed("[3] ", "HB", 2);
+    dedup.requestMode(false, false);
+    TEST_ASSERT_TRUE(dedup.isEnabled());      // До наступного poll/process режим старий
+    dedup.poll(3, collect);
+    TEST_ASSERT_FALSE(dedup.isEnabled());
+    TEST_ASSERT_EQUAL_STRING("[1] HB\n[3] repeated 2 times between [2] and [3]\n", out.c_str());
+    feed("[4] ", "HB", 4);
+    TEST_ASSERT_EQUAL_STRING("[1] HB\n[3] repeated 2 times between [2] and [3]\n[4] HB\n", out.c_str());
+}
+
+static void test_mode_change_applies_before_next_line(void) {
+    feed("[1] ", "v=1", 0);
+    feed("[2] ", "v=1", 1);
+    feed("[3] ", "v=1", 2);
+    dedup.requestMode(true, true);
+    feed("[4] ", "v=2", 3);
+    TEST_ASSERT_TRUE(dedup.isFuzzy());
+    // Серія закрита у старому режимі, новий починається з нового еталона
+    TEST_ASSERT_EQUAL_STRING("[1] v=1\n[3] repeated 2 times between [2] and [3]\n[4] v=2\n", out.c_str());
+    feed("[5] ", "v=3", 4);
+    feed("[6] ", "v=4", 5);
+    dedup.flush(collect);
+    TEST_ASSERT_EQUAL_STRING("[1] v=1\n[3] repeated 2 times between [2] and [3]\n[4] v=2\n"
+                             "[6] repeated 2 times between [5] and [6]\n", out.c_str());
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_run_collapses_to_summary);
+    RUN_TEST(test_single_repeat_passes_verbatim);
+    RUN_TEST(test_fuzzy_ignores_numbers);
+    RUN_TEST(test_poll_bounds_hold_time);
+    RUN_TEST(test_mode_change_flushes_open_run);
+    RUN_TEST(test_mode_change_applies_before_next_line);
+    return UNITY_END();
+}
@@ -0,0 +1,146 @@
+/*
+ * LineFramer: рядки з кільця, сегменти довгих рядків, обрив і зміна ліміту.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "line_framer.h"
+
+#define TEST_RING_BYTES 4096
+#define TEST_MAX_LINE 256
+
+static uint8_t ringStorage[TEST_RING_BYTES];
+static char framerStorage[LINE_FRAMER_BUFFER_SIZE(TEST_MAX_LINE)];
+static std::vector<std::string> lines;
+
+static void collect(const char *line, size_t len) { lines.push_back(std::string(line, len)); }
+
+void setUp(void) { lines.clear(); }
+void tearDown(void) {}
+
+// Пише дані порціями, вичитуючи кільце між ними, як обробник
+static void pump(ByteRing &ring, LineFramer &framer, const std::string &data, size_t chunk) {
+    for (size_t pos = 0; pos < data.size(); pos += chunk) {
+        size_t n = data.size() - pos < chunk ? data.size() - pos : chunk;
+        TEST_ASSERT_EQUAL(n, ring.write((const uint8_t *)data.data() + pos, n));
+        while (framer.next(ring, collect)) {}
+    }
+}
+
+// Склеює сегменти, починаючи з first, назад і перевіряє маркери
+static std::string joinSegments(size_t maxLen, size_t first = 0) {
+    const std::string cont = LINE_CONT_PREFIX, more = LINE_CONT_SUFFIX;
+    std::string joined;
+    for (size_t i = first; i < lines.size(); i++) {
+        std::string s = lines[i];
+        if (i > 0) {
+            TEST_ASSERT_TRUE(s.compare(0, cont.size(), cont) == 0);
+            s = s.substr(cont.size());
+        }
+        if (i + 1 < lines.size()) {
+            TEST_ASSERT_TRUE(s.size() >= more.size() && s.compare(s.size() - more.size(), more.size(), more) == 0);
+            s = s.substr(0, s.size() - more.size());
+        }
+        TEST_ASSERT_LESS_OR_EQUAL(maxLen, s.size());
+        joined += s;
+    }
+    return joined;
+}
+
+static void test_lines_and_crlf(void) {
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    pump(ring, framer, "one\r\ntwo\n\nthree\n", 64);
+    TEST_ASSERT_EQUAL(3, lines.size());
+    TEST_ASSERT_EQUAL_STRING("one", lines[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("three", lines[2].c_str());
+}
+
+// Рядок через кінець кільця і частинами з кількох transfer'ів
+static void test_line_across_ring_wrap(void) {
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    std::string filler(TEST_RING_BYTES - 10, 'f');
+    filler[100] = '\n';
+    filler.back() = '\n';
+    pump(ring, framer, filler, TEST_RING_BYTES);
+    lines.clear();
+    pump(ring, framer, "wrapped-line-text\n", 3);
+    TEST_ASSERT_EQUAL(1, lines.size());
+    TEST_ASSERT_EQUAL_STRING("wrapped-line-text", lines[0].c_str());
+}
+
+// Кілька МБ без '\n': пам'ять не росте, дані не губляться
+static void test_multi_megabyte_line(void) {
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    std::string big(3 * 1024 * 1024, 0);
+    for (size_t i = 0; i < big.size(); i++) big[i] = 'a' + i % 26;
+    pump(ring, framer, big + "\n", 512);
+    TEST_ASSERT_GREATER_THAN(10000, lines.size());
+    TEST_ASSERT_TRUE(joinSegments(TEST_MAX_LINE) == big);
+    TEST_ASSERT_EQUAL(0, framer.pending());
+    TEST_ASSERT_EQUAL(1, framer.stats().lines);
+}
+
+// Відключення посеред рядка - хвіст з маркером обриву, буфер порожній
+static void test_disconnect_mid_line(void) {
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    pump(ring, framer, "done\npartial", 5);
+    TEST_ASSERT_EQUAL(1, lines.size());
+    TEST_ASSERT_TRUE(framer.finish(collect));
+    TEST_ASSERT_EQUAL_STRING("partial" LINE_CUT_SUFFIX, lines[1].c_str());
+    TEST_ASSERT_FALSE(framer.finish(collect));
+    TEST_ASSERT_EQUAL(1, framer.stats().cutLines);
+
+    // Обрив сегментованого рядка: останній шматок з обома маркерами
+    lines.clear();
+    framer.reset();
+    pump(ring, framer, std::string(TEST_MAX_LINE + 10, 'x'), 64);
+    TEST_ASSERT_EQUAL(1, lines.size());
+    TEST_ASSERT_TRUE(framer.finish(collect));
+    TEST_ASSERT_EQUAL_STRING(LINE_CONT_PREFIX "xxxxxxxxxx" LINE_CUT_SUFFIX, lines[1].c_str());
+}
+
+// Ліміт зменшено, поки в буфері більше байт, ніж новий ліміт
+static void test_shrink_below_pending(void) {
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    std::string head(200, 'h');
+    pump(ring, framer, head, 64);
+    TEST_ASSERT_EQUAL(200, framer.pending());
+    TEST_ASSERT_EQUAL(16, framer.requestMaxLineLength(4));
+    std::string tail(3000, 't');
+    pump(ring, framer, tail + "\n", 1024);
+    TEST_ASSERT_EQUAL(16, framer.maxLineLength());
+    TEST_ASSERT_TRUE(lines[0] == head + LINE_CONT_SUFFIX);
+    TEST_ASSERT_TRUE(joinSegments(16, 1) == tail);
+}
+
+static void test_idle_flush(void) {
+    ByteRing ring(ringStorage, sizeof(ringStorage));
+    LineFramer framer(framerStorage, sizeof(framerStorage));
+    framer.setIdleFlushMs(50);
+    pump(ring, framer, "login: ", 64);
+    uint32_t now = loggerMillis();
+    TEST_ASSERT_FALSE(framer.flushIdle(now, collect));
+    TEST_ASSERT_TRUE(framer.flushIdle(now + 50, collect));
+    TEST_ASSERT_EQUAL_STRING("login: " LINE_CONT_SUFFIX, lines[0].c_str());
+    pump(ring, framer, "root\n", 64);
+    TEST_ASSERT_EQUAL_STRING(LINE_CONT_PREFIX "root", lines[1].c_str());
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_lines_and_crlf);
+    RUN_TEST(test_line_across_ring_wrap);
+    RUN_TEST(test_multi_megabyte_line);
+    RUN_TEST(test_disconnect_mid_line);
+    RUN_TEST(test_shrink_below_pending);
+    RUN_TEST(test_idle_flush);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+/*
+ * SinkFanout: політики переповнення і повернення блоків у пул.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <thread>
+#include "log_sink.h"
+
+#define TEST_BLOCK_BYTES 64
+
+static LineBlockPool pool;
+static char memory[4096];
+
+void setUp(void) { pool.begin(8, TEST_BLOCK_BYTES); }
+void tearDown(void) { pool.end(); }
+
+static LineBlock *makeBlock(const char *text) {
+    LineBlock *block = pool.acquire();
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_TRUE(block->appendLine(text, strlen(text)));
+    return block;
+}
+
+static void test_publish_shares_block_between_sinks(void) {
+    SinkFanout fanout;
+    MemorySink a(memory, 64), b(memory + 64, 64);
+    int ia = fanout.add(&a, 4, OverflowPolicy::DROP_NEWEST);
+    int ib = fanout.add(&b, 4, OverflowPolicy::DROP_NEWEST);
+    fanout.publish(makeBlock("x"));
+    TEST_ASSERT_EQUAL(7, pool.available());   // Один блок на обидва sink'и
+    TEST_ASSERT_EQUAL(1, fanout.service(ia));
+    TEST_ASSERT_EQUAL(7, pool.available());
+    TEST_ASSERT_EQUAL(1, fanout.service(ib));
+    TEST_ASSERT_EQUAL(8, pool.available());
+    TEST_ASSERT_EQUAL_STRING_LEN("x\n", memory, 2);
+    TEST_ASSERT_EQUAL_STRING_LEN("x\n", memory + 64, 2);
+}
+
+static void test_drop_newest_keeps_queue_head(void) {
+    SinkFanout fanout;
+    MemorySink sink(memory, sizeof(memory));
+    int i = fanout.add(&sink, 2, OverflowPolicy::DROP_NEWEST);
+    fanout.publish(makeBlock("a"));
+    fanout.publish(makeBlock("b"));
+    fanout.publish(makeBlock("c"));
+    TEST_ASSERT_EQUAL(1, fanout.metrics(i).blocksDropped);
+    TEST_ASSERT_EQUAL(6, pool.available());   // Відкинутий блок уже в пулі
+    fanout.service(i);
+    TEST_ASSERT_EQUAL(4, sink.length());
+    TEST_ASSERT_EQUAL_STRING_LEN("a\nb\n", memory, 4);
+}
+
+static void test_drop_oldest_keeps_fresh_data(void) {
+    SinkFanout fanout;
+    MemorySink sink(memory, sizeof(memory));
+    int i = fanout.add(&sink, 2, OverflowPolicy::DROP_OLDEST);
+    fanout.publish(makeBlock("a"));
+    fanout.publish(makeBlock("b"));
+    fanout.publish(makeBlock("c"));
+    TEST_ASSERT_EQUAL(1, fanout.metrics(i).blocksDropped);
+    TEST_ASSERT_EQUAL(6, pool.available());
+    fanout.service(i);
+    TEST_ASSERT_EQUAL_STRING_LEN("b\nc\n", memory, 4);
+}
+
+// Переповнений повільний sink не зачіпає сусіда
+static void test_full_sink_does_not_starve_other(void) {
+    SinkFanout fanout;
+    MemorySink slow(memory, 64), fast(memory + 64, 1024);
+    int is = fanout.add(&slow, 1, OverflowPolicy::DROP_NEWEST);
+    int iff = fanout.add(&fast, 4, OverflowPolicy::DROP_NEWEST);
+    for (int n = 0; n < 4; n++) {
+        fanout.publish(makeBlock("z"));
+        fanout.service(iff);
+    }
+    TEST_ASSERT_EQUAL(4, fanout.metrics(iff).blocksWritten);
+    TEST_ASSERT_EQUAL(0, fanout.metrics(iff).blocksDropped);
+    TEST_ASSERT_EQUAL(3, fanout.metrics(is).blocksDropped);
+    TEST_ASSERT_EQUAL(0, fanout.metrics(is).blockedUs);
+}
+
+static void test_block_gives_up_after_timeout(void) {
+    SinkFanout fanout;
+    MemorySink sink(memory, sizeof(memory));
+    int i = fanout.add(&sink, 1, OverflowPolicy::BLOCK, 5);
+    fanout.publish(makeBlock("a"));
+    fanout.publish(makeBlock("b"));
+    TEST_ASSERT_EQUAL(1, fanout.metrics(i).blocksDropped);
+    TEST_ASSERT_GREATER_OR_EQUAL(4000, fanout.metrics(i).blockedUs);   // Таймаут міряється в мс
+    TEST_ASSERT_EQUAL(7, pool.available());
+}
+
+static void test_disable_returns_queued_blocks(void) {
+    SinkFanout fanout;
+    MemorySink sink(memory, sizeof(memory));
+    int i = fanout.add(&sink, 4, OverflowPolicy::DROP_NEWEST);
+    fanout.publish(makeBlock("a"));
+    fanout.publish(makeBlock("b"));
+    TEST_ASSERT_EQUAL(6, pool.available());
+    fanout.setEnabled(i, false);
+    TEST_ASSERT_EQUAL(8, pool.available());
+    fanout.publish(makeBlock("c"));
+    TEST_ASSERT_EQUAL(8, pool.available());
+    TEST_ASSERT_EQUAL(0, fanout.queued(i));
+}
+
+// Продюсер, потік sink'а і loop() з командами працюють одночасно: жоден блок
+// не губиться з лічильників і не лишається поза пулом
+static void test_metrics_from_concurrent_threads(void) {
+    SinkFanout fanout;
+    MemorySink sink(memory, sizeof(memory));
+    int i = fanout.add(&sink, 2, OverflowPolicy::DROP_NEWEST);
+    const uint32_t total = 20000;
+    std::atomic<bool> done(false);
+
+    std::thread writer([&] {
+        while (!done.load()) fanout.service(i);
+        fanout.service(i);
+    });
+    std::thread control([&] {
+        while (!done.load()) {
+            fanout.setEnabled(i, true);
+            fanout.metrics(i);
+        }
+    });
+    uint32_t published = 0;
+    while (published < total) {
+        LineBlock *block = pool.acquire();
+        if (block == NULL) continue;
+        block->appendLine("x", 1);
+        fanout.publish(block);
+        published++;
+    }
+    done.store(true);
+    writer.join();
+    control.join();
+
+    SinkMetrics m = fanout.metrics(i);
+    TEST_ASSERT_EQUAL(total, m.blocksQueued + m.blocksDropped);
+    TEST_ASSERT_EQUAL(m.blocksQueued, m.blocksWritten);
+    TEST_ASSERT_TRUE(m.maxDepth <= 2);
+    TEST_ASSERT_EQUAL(8, pool.available());
+    fanout.resetMetrics(i);
+    TEST_ASSERT_EQUAL(0, fanout.metrics(i).blocksWritten);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_publish_shares_block_between_sinks);
+    RUN_TEST(test_drop_newest_keeps_queue_head);
+    RUN_TEST(test_drop_oldest_keeps_fresh_data);
+    RUN_TEST(test_full_sink_does_not_starve_other);
+    RUN_TEST(test_block_gives_up_after_timeout);
+    RUN_TEST(test_disable_returns_queued_blocks);
+    RUN_TEST(test_metrics_from_concurrent_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,157 @@
+/*
+ * TelemetryStore: розбір рядків і кодування - запис у .tlm і назад
+ * дає ті самі числа; схожі на телеметрію повідомлення лишаються текстом.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <stdint.h>
+#include <vector>
+#include "telemetry_store.h"
+
+static const TelemetrySchema ENV = { "env", TelemetryFormat::KEY_VALUE, "", 2, 2, { "temp", "hum" } };
+static const TelemetrySchema IMU = { "imu", TelemetryFormat::CSV, "$IMU,", 3, 3, { "ax", "ay", "az" } };
+
+static std::vector<uint8_t> file;
+
+static void collect(const uint8_t *data, size_t len, void *ctx) {
+    (void)ctx;
+    file.insert(file.end(), data, data + len);
+}
+
+void setUp(void) { file.clear(); }
+void tearDown(void) {}
+
+struct Row {
+    int schema;
+    std::vector<int64_t> values;   // Колонка 0 - час
+};
+
+// Читач блоків .tlm: zigzag-varint, перше значення абсолютне, далі дельти
+static std::vector<Row> decode(const std::vector<uint8_t> &data) {
+    std::vector<Row> rows;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        TEST_ASSERT_TRUE(pos + 6 <= data.size());
+        TEST_ASSERT_EQUAL('T', data[pos]);
+        TEST_ASSERT_EQUAL('B', data[pos + 1]);
+        int schema = data[pos + 2];
+        int columns = data[pos + 3];
+        int count = data[pos + 4] | (data[pos + 5] << 8);
+        pos += 6;
+        std::vector<uint32_t> lengths(columns);
+        for (int c = 0; c < columns; c++, pos += 4) {
+            lengths[c] = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | ((uint32_t)data[pos + 3] << 24);
+        }
+        size_t first = rows.size();
+        for (int r = 0; r < count; r++) rows.push_back(Row{ schema, std::vector<int64_t>(columns) });
+        for (int c = 0; c < columns; c++) {
+            size_t p = pos;
+            int64_t last = 0;
+            for (int r = 0; r < count; r++) {
+                uint64_t zz = 0;
+                int shift = 0;
+                do {
+                    zz |= (uint64_t)(data[p] & 0x7F) << shift;
+                    shift += 7;
+                } while (data[p++] & 0x80);
+                int64_t delta = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+                last = r == 0 ? delta : last + delta;
+                rows[first + r].values[c] = last;
+            }
+            TEST_ASSERT_EQUAL(lengths[c], p - pos);
+            pos = p;
+        }
+    }
+    return rows;
+}
+
+static bool append(TelemetryStore &store, const char *line, uint64_t timeMs) {
+    return store.append(line, strlen(line), timeMs);
+}
+
+static void begin(TelemetryStore &store) {
+    store.addSchema(ENV);
+    store.addSchema(IMU);
+    store.setOutput(collect, NULL);
+    store.setEnabled(true);
+}
+
+static void test_round_trip(void) {
+    TelemetryStore store;
+    begin(store);
+    TEST_ASSERT_TRUE(append(store, "temp=21.50 hum=40", 1000));
+    TEST_ASSERT_TRUE(append(store, "$IMU,0.012,-0.004,9.807", 1001));
+    TEST_ASSERT_TRUE(append(store, "hum=41.2;temp=-3.1\r", 2000));
+    TEST_ASSERT_TRUE(append(store, "$IMU,-1,2.5,+3", 2001));
+    TEST_ASSERT_TRUE(append(store, "temp=9999999999999999.99 hum=-9999999999999999.99", 3000));
+    store.flush();
+
+    std::vector<Row> rows = decode(file);
+    TEST_ASSERT_EQUAL(5, rows.size());
+    // Блоки по схемах: спершу env, потім imu
+    TEST_ASSERT_EQUAL(0, rows[0].schema);
+    TEST_ASSERT_EQUAL_INT64(1000, rows[0].values[0]);
+    TEST_ASSERT_EQUAL_INT64(2150, rows[0].values[1]);
+    TEST_ASSERT_EQUAL_INT64(4000, rows[0].values[2]);
+    TEST_ASSERT_EQUAL_INT64(-310, rows[1].values[1]);
+    TEST_ASSERT_EQUAL_INT64(4120, rows[1].values[2]);
+    TEST_ASSERT_EQUAL_INT64(999999999999999999LL, rows[2].values[1]);
+    TEST_ASSERT_EQUAL_INT64(-999999999999999999LL, rows[2].values[2]);
+    TEST_ASSERT_EQUAL(1, rows[3].schema);
+    TEST_ASSERT_EQUAL_INT64(1001, rows[3].values[0]);
+    TEST_ASSERT_EQUAL_INT64(12, rows[3].values[1]);
+    TEST_ASSERT_EQUAL_INT64(-4, rows[3].values[2]);
+    TEST_ASSERT_EQUAL_INT64(9807, rows[3].values[3]);
+    TEST_ASSERT_EQUAL_INT64(-1000, rows[4].values[1]);
+    TEST_ASSERT_EQUAL_INT64(3000, rows[4].values[3]);
+    TEST_ASSERT_EQUAL(5, store.stats().linesMatched);
+}
+
+// Схожі на телеметрію, але не вона - лишаються в текстовому лозі
+static void test_near_misses_stay_text(void) {
+    TelemetryStore store;
+    begin(store);
+    const char *lines[] = {
+        "Error: temp=85 hum=40 overheat shutting down",
+        "temp=21 hum=40 seq=7",
+        "temp=21 temp=22 hum=40",
+        "temp=21",
+        "temp=21 hum=abc",
+        "temp=99999999999999999999999 hum=1",
+        "temp=10000000000000000 hum=1",
+        "$IMU,1,2",
+        "$IMU,1,2,3,4",
+        "$IMU,1,2,99999999999999999999",
+    };
+    for (const char *line : lines) {
+        if (append(store, line, 1)) TEST_FAIL_MESSAGE(line);
+    }
+    TEST_ASSERT_EQUAL(sizeof(lines) / sizeof(lines[0]), store.stats().linesUnmatched);
+    store.flush();
+    TEST_ASSERT_EQUAL(0, file.size());
+}
+
+static void test_parse_fixed_limits(void) {
+    int64_t v = 0;
+    const char *max = "999999999999999999";
+    TEST_ASSERT_TRUE(TelemetryStore::parseFixed(max, max + strlen(max), 0, &v));
+    TEST_ASSERT_EQUAL_INT64(TELEMETRY_MAX_VALUE, v);
+    const char *over = "1000000000000000000";
+    TEST_ASSERT_FALSE(TelemetryStore::parseFixed(over, over + strlen(over), 0, &v));
+    // Переповнення через масштаб 10^decimals
+    const char *scaled = "10000000000000000";
+    TEST_ASSERT_FALSE(TelemetryStore::parseFixed(scaled, scaled + strlen(scaled), 2, &v));
+    const char *extra = "1.23456";
+    TEST_ASSERT_TRUE(TelemetryStore::parseFixed(extra, extra + strlen(extra), 2, &v));
+    TEST_ASSERT_EQUAL_INT64(123, v);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_near_misses_stay_text);
+    RUN_TEST(test_parse_fixed_limits);
+    return UNITY_END();
+}
@@ -0,0 +1,230 @@
+/*
+ * UsbConfigLayout і сповіщення CDC на дескрипторах реальних пристроїв.
+ * Запуск на ПК: pio test -e native
+ */
+#include <unity.h>
+#include <vector>
+#include "usb_descriptors.h"
+
+// CP2102: один vendor-інтерфейс, bulk IN 0x81 / OUT 0x01 (lsusb -v)
+static const uint8_t CP210X_CONFIG[] = {
+    0x09, 0x02, 0x20, 0x00, 0x01, 0x01, 0x00, 0x80, 0x32,
+    0x09, 0x04, 0x00, 0x00, 0x02, 0xFF, 0x00, 0x00, 0x02,
+    0x07, 0x05, 0x81, 0x02, 0x40, 0x00, 0x00,
+    0x07, 0x05, 0x01, 0x02, 0x40, 0x00, 0x00,
+};
+
+// TinyUSB dual-CDC (cdc_dual_ports): дві функції IAD, у кожній
+// керування з interrupt IN і Data з bulk IN/OUT
+static const uint8_t DUAL_CDC_CONFIG[] = {
+    0x09, 0x02, 0x8D, 0x00, 0x04, 0x01, 0x00, 0x80, 0x32,
+    // Функція 0: інтерфейси 0-1
+    0x08, 0x0B, 0x00, 0x02, 0x02, 0x02, 0x00, 0x00,
+    0x09, 0x04, 0x00, 0x00, 0x01, 0x02, 0x02, 0x00, 0x04,
+    0x05, 0x24, 0x00, 0x20, 0x01,
+    0x05, 0x24, 0x01, 0x00, 0x01,
+    0x04, 0x24, 0x02, 0x02,
+    0x05, 0x24, 0x06, 0x00, 0x01,
+    0x07, 0x05, 0x81, 0x03, 0x08, 0x00, 0x10,
+    0x09, 0x04, 0x01, 0x00, 0x02, 0x0A, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x02, 0x02, 0x40, 0x00, 0x00,
+    0x07, 0x05, 0x82, 0x02, 0x40, 0x00, 0x00,
+    // Функція 1: інтерфейси 2-3
+    0x08, 0x0B, 0x02, 0x02, 0x02, 0x02, 0x00, 0x00,
+    0x09, 0x04, 0x02, 0x00, 0x01, 0x02, 0x02, 0x00, 0x05,
+    0x05, 0x24, 0x00, 0x20, 0x01,
+    0x05, 0x24, 0x01, 0x00, 0x03,
+    0x04, 0x24, 0x02, 0x02,
+    0x05, 0x24, 0x06, 0x02, 0x03,
+    0x07, 0x05, 0x83, 0x03, 0x08, 0x00, 0x10,
+    0x09, 0x04, 0x03, 0x00, 0x02, 0x0A, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x04, 0x02, 0x40, 0x00, 0x00,
+    0x07, 0x05, 0x84, 0x02, 0x40, 0x00, 0x00,
+};
+
+// Vendor-інтерфейс трасування з альтернативним налаштуванням, яке не беремо
+static const uint8_t VENDOR_TRACE_INTERFACE[] = {
+    0x09, 0x04, 0x04, 0x00, 0x01, 0xFF, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x85, 0x02, 0x40, 0x00, 0x00,
+    0x09, 0x04, 0x04, 0x01, 0x01, 0xFF, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x86, 0x02, 0x40, 0x00, 0x00,
+};
+
+static const UsbStreamSelection DEFAULT_SELECTION = { USB_STREAM_CDC_DATA | USB_STREAM_VENDOR, 0 };
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Склеює дескриптор конфігурації з доданими інтерфейсами, wTotalLength і bNumInterfaces
+static std::vector<uint8_t> compose(const uint8_t *config, size_t len, const uint8_t *extra, size_t extraLen,
+                                    uint8_t extraInterfaces) {
+    std::vector<uint8_t> d(config, config + len);
+    d.insert(d.end(), extra, extra + extraLen);
+    d[2] = (uint8_t)(d.size() & 0xFF);
+    d[3] = (uint8_t)(d.size() >> 8);
+    d[4] += extraInterfaces;
+    return d;
+}
+
+static int streamCount(const UsbConfigLayout &layout, const UsbStreamSelection &sel) {
+    int n = 0;
+    for (int i = 0; i < layout.endpointsCount(); i++) n += layout.matches(layout.endpointAt(i), sel) ? 1 : 0;
+    return n;
+}
+
+static void test_cp210x_single_vendor_stream(void) {
+    UsbConfigLayout layout;
+    TEST_ASSERT_TRUE(layout.parse(CP210X_CONFIG, sizeof(CP210X_CONFIG)));
+    TEST_ASSERT_EQUAL(1, layout.interfacesCount());
+    TEST_ASSERT_EQUAL(2, layout.endpointsCount());
+    TEST_ASSERT_EQUAL(0, layout.functionsCount());
+    TEST_ASSERT_FALSE(layout.isTruncated());
+
+    const UsbEndpointInfo &in = layout.endpointAt(0);
+    TEST_ASSERT_EQUAL_HEX8(0x81, in.address);
+    TEST_ASSERT_EQUAL(64, in.maxPacket);
+    TEST_ASSERT_TRUE(layout.matches(in, DEFAULT_SELECTION));
+    TEST_ASSERT_FALSE(layout.matches(layout.endpointAt(1), DEFAULT_SELECTION));
+    TEST_ASSERT_FALSE(layout.isNotification(in));
+    TEST_ASSERT_EQUAL(-1, layout.controlInterfaceFor(in));
+
+    UsbStreamSelection cdcOnly = { USB_STREAM_CDC_DATA, 0 };
+    TEST_ASSERT_FALSE(layout.matches(in, cdcOnly));
+}
+
+static void test_dual_cdc_functions_and_unions(void) {
+    UsbConfigLayout layout;
+    TEST_ASSERT_TRUE(layout.parse(DUAL_CDC_CONFIG, sizeof(DUAL_CDC_CONFIG)));
+    TEST_ASSERT_EQUAL(4, layout.interfacesCount());
+    TEST_ASSERT_EQUAL(6, layout.endpointsCount());
+    TEST_ASSERT_EQUAL(2, layout.functionsCount());
+    TEST_ASSERT_EQUAL_HEX8(USBDESC_CLASS_CDC, layout.functionClassAt(1));
+    TEST_ASSERT_EQUAL(1, layout.interfaceAt(3).function);
+    TEST_ASSERT_EQUAL(2, layout.interfaceAt(3).controlInterface);
+    TEST_ASSERT_EQUAL(2, streamCount(layout, DEFAULT_SELECTION));
+
+    int notifications = 0;
+    for (int i = 0; i < layout.endpointsCount(); i++) {
+        const UsbEndpointInfo &ep = layout.endpointAt(i);
+        if (layout.isNotification(ep)) {
+            notifications++;
+            TEST_ASSERT_EQUAL(USBDESC_EP_INTERRUPT, ep.type);
+        }
+        if (ep.address == 0x82) TEST_ASSERT_EQUAL(0, layout.controlInterfaceFor(ep));
+        if (ep.address == 0x84) TEST_ASSERT_EQUAL(2, layout.controlInterfaceFor(ep));
+    }
+    TEST_ASSERT_EQUAL(2, notifications);
+
+    // Маска інтерфейсів: тільки другий порт
+    UsbStreamSelection second = { USB_STREAM_CDC_DATA | USB_STREAM_VENDOR, 1UL << 3 };
+    TEST_ASSERT_EQUAL(1, streamCount(layout, second));
+}
+
+// Без Union керування шукається в тій самій функції IAD
+static void test_control_interface_from_iad_without_union(void) {
+    std::vector<uint8_t> d(DUAL_CDC_CONFIG, DUAL_CDC_CONFIG + sizeof(DUAL_CDC_CONFIG));
+    for (size_t i = 9; i + 2 < d.size(); i += d[i]) {
+        if (d[i + 1] == USBDESC_TYPE_CS_INTERFACE && d[i + 2] == USBDESC_CDC_SUBTYPE_UNION) d[i + 2] = 0x7F;
+    }
+    UsbConfigLayout layout;
+    TEST_ASSERT_TRUE(layout.parse(d.data(), d.size()));
+    TEST_ASSERT_EQUAL(-1, layout.interfaceAt(3).controlInterface);
+    for (int i = 0; i < layout.endpointsCount(); i++) {
+        const UsbEndpointInfo &ep = layout.endpointAt(i);
+        if (ep.address == 0x84) TEST_ASSERT_EQUAL(2, layout.controlInterfaceFor(ep));
+    }
+}
+
+// dual-CDC + vendor trace: три потоки, alt 1 vendor-інтерфейсу пропущено
+static void test_dual_cdc_with_vendor_trace(void) {
+    std::vector<uint8_t> d = compose(DUAL_CDC_CONFIG, sizeof(DUAL_CDC_CONFIG),
+                                     VENDOR_TRACE_INTERFACE, sizeof(VENDOR_TRACE_INTERFACE), 1);
+    UsbConfigLayout layout;
+    TEST_ASSERT_TRUE(layout.parse(d.data(), d.size()));
+    TEST_ASSERT_EQUAL(5, layout.interfacesCount());
+    TEST_ASSERT_EQUAL(7, layout.endpointsCount());
+    TEST_ASSERT_EQUAL(-1, layout.interfaceAt(4).function);
+    TEST_ASSERT_EQUAL(3, streamCount(layout, DEFAULT_SELECTION));
+    UsbStreamSelection vendorOnly = { USB_STREAM_VENDOR, 0 };
+    TEST_ASSERT_EQUAL(1, streamCount(layout, vendorOnly));
+    TEST_ASSERT_EQUAL(-1, layout.controlInterfaceFor(layout.endpointAt(6)));
+}
+
+// Bulk IN іншого класу (mass storage) - тільки з USB_STREAM_OTHER
+static void test_other_class_needs_explicit_selection(void) {
+    static const uint8_t msc[] = {
+        0x09, 0x04, 0x04, 0x00, 0x02, 0x08, 0x06, 0x50, 0x00,
+        0x07, 0x05, 0x85, 0x02, 0x40, 0x00, 0x00,
+        0x07, 0x05, 0x05, 0x02, 0x40, 0x00, 0x00,
+    };
+    std::vector<uint8_t> d = compose(CP210X_CONFIG, sizeof(CP210X_CONFIG), msc, sizeof(msc), 1);
+    UsbConfigLayout layout;
+    TEST_ASSERT_TRUE(layout.parse(d.data(), d.size()));
+    TEST_ASSERT_EQUAL(1, streamCount(layout, DEFAULT_SELECTION));
+    UsbStreamSelection any = { USB_STREAM_ANY, 0 };
+    TEST_ASSERT_EQUAL(2, streamCount(layout, any));
+}
+
+static void test_malformed_descriptors(void) {
+    UsbConfigLayout layout;
+    TEST_ASSERT_FALSE(layout.parse(CP210X_CONFIG, 3));
+    TEST_ASSERT_FALSE(layout.parse(CP210X_CONFIG + 9, sizeof(CP210X_CONFIG) - 9));
+
+    // Нульова довжина дескриптора
+    std::vector<uint8_t> d(CP210X_CONFIG, CP210X_CONFIG + sizeof(CP210X_CONFIG));
+    d[18] = 0;
+    TEST_ASSERT_FALSE(layout.parse(d.data(), d.size()));
+
+    // Хвіст за wTotalLength ігнорується
+    d.assign(CP210X_CONFIG, CP210X_CONFIG + sizeof(CP210X_CONFIG));
+    d[2] = 25;
+    TEST_ASSERT_TRUE(layout.parse(d.data(), d.size()));
+    TEST_ASSERT_EQUAL(1, layout.endpointsCount());
+}
+
+static void test_serial_state_notification(void) {
+    static const uint8_t raw[] = { 0xA1, 0x20, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0x45, 0x00 };
+    CdcNotification n;
+    TEST_ASSERT_TRUE(parseCdcNotification(raw, sizeof(raw), n));
+    TEST_ASSERT_TRUE(n.hasState);
+    TEST_ASSERT_EQUAL(2, n.interfaceNumber);
+    char buf[128];
+    size_t len = formatCdcNotification(n, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("CDC if2 SERIAL_STATE DCD=1 DSR=0 BREAK OVERRUN", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+
+    // Заголовок без даних і обрізаний вивід
+    TEST_ASSERT_TRUE(parseCdcNotification(raw, 8, n));
+    TEST_ASSERT_FALSE(n.hasState);
+    len = formatCdcNotification(n, buf, 8);
+    TEST_ASSERT_EQUAL(7, len);
+    TEST_ASSERT_EQUAL_STRING("CDC if2", buf);
+
+    TEST_ASSERT_FALSE(parseCdcNotification(raw, 7, n));
+    static const uint8_t wrongType[] = { 0x21, 0x20, 0, 0, 0, 0, 0, 0 };
+    TEST_ASSERT_FALSE(parseCdcNotification(wrongType, sizeof(wrongType), n));
+}
+
+static void test_network_connection_notification(void) {
+    static const uint8_t raw[] = { 0xA1, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    CdcNotification n;
+    TEST_ASSERT_TRUE(parseCdcNotification(raw, sizeof(raw), n));
+    char buf[64];
+    formatCdcNotification(n, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("CDC if0 NETWORK_CONNECTION connected", buf);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_cp210x_single_vendor_stream);
+    RUN_TEST(test_dual_cdc_functions_and_unions);
+    RUN_TEST(test_control_interface_from_iad_without_union);
+    RUN_TEST(test_dual_cdc_with_vendor_trace);
+    RUN_TEST(test_other_class_needs_explicit_selection);
+    RUN_TEST(test_malformed_descriptors);
+    RUN_TEST(test_serial_state_notification);
+    RUN_TEST(test_network_connection_notification);
+    return UNITY_END();
+}
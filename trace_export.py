@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""
+Trace Export - перетворює вивантаження трасування логера (команда trace)
+у Chrome trace JSON для chrome://tracing або ui.perfetto.dev.
+
+Вхід - сирий бінарний дамп (починається з TRC1) або збережений вивід
+Serial, де дамп обрамлено рядками "[TRACE] BEGIN <байт>" і "[TRACE] END".
+З --port скрипт сам надсилає команду trace і читає відповідь.
+
+Прошивка має бути зібрана з build_flags = -DLOGGER_TRACE.
+
+Приклади:
+    python trace_export.py capture.txt -o trace.json
+    python trace_export.py --port COM5 -o trace.json
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"TRC1"
+BEGIN_MARKER = b"[TRACE] BEGIN "
+
+# Типи подій - як TraceEventType у include/trace.h
+USB_TRANSFER = 1
+USB_RESUBMIT = 2
+BATCH_BEGIN = 3
+BATCH_END = 4
+SD_WRITE_BEGIN = 5
+SD_WRITE_END = 6
+SD_FLUSH_BEGIN = 7
+SD_FLUSH_END = 8
+OVERFLOW = 9
+
+OVERFLOW_SOURCES = {0: "usb-ring", 1: "sink-queue", 2: "block-pool"}
+SD_FILES = {0: "log", 1: "telemetry"}
+
+# Доріжки (tid) - по задачі, а не по ядру: задачі не прив'язані до ядер і
+# мігрують, тому begin і end одного span'у можуть лягти в кільця різних ядер
+TRACK_USB = 1
+TRACK_BATCH = 2
+TRACK_SD = 10  # + номер файлу
+TRACE_PID = 0
+TRACK_NAMES = {TRACK_USB: "USB Host", TRACK_BATCH: "обробник буфера"}
+
+
+def fnv1a(data):
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def extract_dump(data):
+    """Повертає бінарний дамп із сирого файлу або з виводу Serial"""
+    if data.startswith(MAGIC):
+        return data
+    pos = data.rfind(BEGIN_MARKER)
+    if pos < 0:
+        raise ValueError("Дамп не знайдено: немає сигнатури TRC1 і рядка [TRACE] BEGIN")
+    line_end = data.index(b"\n", pos)
+    length = int(data[pos + len(BEGIN_MARKER):line_end])
+    dump = data[line_end + 1:line_end + 1 + length]
+    if len(dump) < length:
+        raise ValueError(f"Дамп обрізано: {len(dump)} з {length} байт")
+    return dump
+
+
+def parse_dump(dump):
+    """Повертає (час вивантаження, [(ядро, перезаписано, [(час, тип, aux, arg)])])"""
+    if len(dump) < 20 or dump[:4] != MAGIC:
+        raise ValueError("Це не дамп трасування (немає сигнатури TRC1)")
+    (checksum,) = struct.unpack_from("<I", dump, len(dump) - 4)
+    if fnv1a(dump[:-4]) != checksum:
+        raise ValueError("Контрольна сума не збігається - дамп пошкоджено при передачі")
+
+    cores, record_size, _, dump_time, _ = struct.unpack_from("<BBHII", dump, 4)
+    if record_size != 8:
+        raise ValueError(f"Невідомий розмір події: {record_size}")
+    pos = 16
+    result = []
+    for core in range(cores):
+        lost, count = struct.unpack_from("<II", dump, pos)
+        pos += 8
+        events = [struct.unpack_from("<IBBH", dump, pos + i * 8) for i in range(count)]
+        pos += count * 8
+        result.append((core, lost, events))
+    return dump_time, result
+
+
+def to_chrome(dump_time, cores):
+    """Події ядер -> список подій Chrome trace (мкс від найстарішої події)
+
+    Кільця всіх ядер зводяться в одну шкалу часу і один процес; пари
+    begin/end шукаються по доріжці, ядро лишається в args."""
+    # Час - 32-бітні мкс, що переповнюються раз на ~71 хв: рахуємо вік відносно моменту вивантаження
+    ages = [(dump_time - t) & 0xFFFFFFFF for _, _, events in cores for t, _, _, _ in events]
+    oldest = max(ages) if ages else 0
+    trace = [{"ph": "M", "name": "process_name", "pid": TRACE_PID, "args": {"name": "Логер"}}]
+    tracks = set()
+    open_spans = {}
+    # Стабільне сортування: події з однаковим часом лишаються в порядку ядра і кільця
+    timeline = sorted(((oldest - ((dump_time - t) & 0xFFFFFFFF), core, kind, aux, arg)
+                       for core, _, events in cores for t, kind, aux, arg in events),
+                      key=lambda e: e[0])
+    for ts, core, kind, aux, arg in timeline:
+        event = {"pid": TRACE_PID, "ts": ts}
+        if kind == USB_TRANSFER:
+            event.update(ph="i", s="t", tid=TRACK_USB, name="usb transfer", args={"ep": f"0x{aux:02X}", "bytes": arg})
+        elif kind == USB_RESUBMIT:
+            event.update(ph="i", s="t", tid=TRACK_USB, name="resubmit" if arg == 0 else "resubmit failed",
+                         args={"ep": f"0x{aux:02X}"})
+        elif kind in (BATCH_BEGIN, BATCH_END):
+            event.update(tid=TRACK_BATCH, name="batch")
+            if kind == BATCH_BEGIN:
+                event.update(ph="B", args={"limit": arg})
+            else:
+                event.update(ph="E", args={"lines": arg})
+        elif kind in (SD_WRITE_BEGIN, SD_WRITE_END, SD_FLUSH_BEGIN, SD_FLUSH_END):
+            tid = TRACK_SD + aux
+            TRACK_NAMES.setdefault(tid, f"SD {SD_FILES.get(aux, aux)}")
+            name = "sd write" if kind in (SD_WRITE_BEGIN, SD_WRITE_END) else "sd flush"
+            event.update(tid=tid, name=name)
+            if kind == SD_WRITE_BEGIN:
+                event.update(ph="B", args={"bytes": arg})
+            elif kind == SD_WRITE_END:
+                event.update(ph="E", args={"ok": bool(arg)})
+            else:
+                event.update(ph="B" if kind == SD_FLUSH_BEGIN else "E")
+        elif kind == OVERFLOW:
+            source = OVERFLOW_SOURCES.get(aux, str(aux))
+            tid = TRACK_USB if aux == 0 else TRACK_BATCH
+            event.update(ph="i", s="p", tid=tid, name=f"overflow {source}", args={"lost": arg})
+        else:
+            continue
+        event.setdefault("args", {})["core"] = core
+
+        # Початок span'у міг бути перезаписаний у кільці - кінець без пари пропускаємо
+        key = (event["tid"], event["name"])
+        if event["ph"] == "B":
+            open_spans[key] = open_spans.get(key, 0) + 1
+        elif event["ph"] == "E":
+            if not open_spans.get(key):
+                continue
+            open_spans[key] -= 1
+        tracks.add(event["tid"])
+        trace.append(event)
+
+    for tid in sorted(tracks):
+        trace.append({"ph": "M", "name": "thread_name", "pid": TRACE_PID, "tid": tid,
+                      "args": {"name": TRACK_NAMES.get(tid, str(tid))}})
+    for core, lost, _ in cores:
+        if lost:
+            print(f"Ядро {core}: {lost} найстаріших подій перезаписано в кільці", file=sys.stderr)
+    return trace
+
+
+def read_from_port(port, baud, timeout):
+    """Надсилає команду trace і повертає вивід до маркера [TRACE] END"""
+    import serial
+
+    with serial.Serial(port, baud, timeout=timeout) as link:
+        link.reset_input_buffer()
+        link.write(b"trace\n")
+        data = bytearray()
+        while True:
+            chunk = link.read(4096)
+            if not chunk:
+                raise ValueError("Логер не відповів повним дампом (зібрано з -DLOGGER_TRACE?)")
+            data += chunk
+            pos = data.find(BEGIN_MARKER)
+            if pos < 0:
+                continue
+            line_end = data.find(b"\n", pos)
+            if line_end < 0:
+                continue
+            length = int(data[pos + len(BEGIN_MARKER):line_end])
+            if len(data) >= line_end + 1 + length:
+                return bytes(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Експорт трасування логера в Chrome trace JSON")
+    parser.add_argument("file", nargs="?", help="дамп трасування або збережений вивід Serial")
+    parser.add_argument("--port", help="COM порт логера - прочитати дамп напряму")
+    parser.add_argument("--baud", type=int, default=115200, help="швидкість порту")
+    parser.add_argument("--timeout", type=float, default=10.0, help="тиша на порту, після якої здаємось, с")
+    parser.add_argument("-o", "--output", help="JSON файл (за замовчуванням - stdout)")
+    args = parser.parse_args()
+
+    if not args.file and not args.port:
+        parser.error("вкажіть файл або --port")
+
+    try:
+        if args.port:
+            data = read_from_port(args.port, args.baud, args.timeout)
+        else:
+            with open(args.file, "rb") as f:
+                data = f.read()
+        dump_time, cores = parse_dump(extract_dump(data))
+        trace = to_chrome(dump_time, cores)
+    except (OSError, ValueError) as e:
+        print(f"Помилка: {e}", file=sys.stderr)
+        return 1
+
+    document = {"traceEvents": trace, "displayTimeUnit": "ms"}
+    events = sum(len(events) for _, _, events in cores)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as out:
+            json.dump(document, out, ensure_ascii=False)
+        print(f"Експортовано {events} подій у {args.output}", file=sys.stderr)
+    else:
+        json.dump(document, sys.stdout, ensure_ascii=False)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())